@@ -0,0 +1,59 @@
+#ifndef FAST_FIBONACCI_H_
+#define FAST_FIBONACCI_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+ *  C/C++ interface of the kernels in Fast_Fibonacci.s (System V ABI).
+ *  Assemble it without _start:
+ *      as --defsym FIB_LIBRARY=1 Fast_Fibonacci.s -o fib_kernels.o
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* F(n) by the O(n) loop of the program, over a 3-slot array in .data: not reentrant */
+uint64_t fastFib(uint32_t n);
+
+/* F(n) by fast doubling in O(log(n)). Exact for n <= 93, F(n) mod 2^64 above */
+uint64_t fib_doubling(uint64_t n);
+
+/* F(n) in one table load. n > 93 saturates to UINT64_MAX, without a branch */
+uint64_t fib_u64(uint64_t n);
+
+/* *out = fib_u64(n). Returns 1 if F(n) fits in 64 bits (n <= 93), 0 if it overflows */
+int fib_checked(uint64_t n, uint64_t* out);
+
+/* F(n) mod m for any 64-bit n & m, in O(log(n)). m <= 1 gives 0 */
+uint64_t fib_mod(uint64_t n, uint64_t m);
+
+/* out[i] = fib_mod(n[i], m[i]), four interleaved queries at a time. out may be n or m */
+void fib_mod_batch(const uint64_t* n, const uint64_t* m, uint64_t* out, size_t count);
+
+
+/*
+ *  Limb kernels of the big-integer engine (Fast_Fibonacci_Big.h).
+ *  A number is an array of 64-bit limbs, the least significant first.
+ */
+
+/* r = a + b over n limbs, returns the carry. r may be a or b */
+uint64_t fib_limbs_add(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n);
+
+/* r = a - b over n limbs, returns the borrow. r may be a or b */
+uint64_t fib_limbs_sub(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n);
+
+/* r += a * m over n limbs, returns the carried limb */
+uint64_t fib_limbs_addmul_1(uint64_t* r, const uint64_t* a, size_t n, uint64_t m);
+
+/* q = a / d over n limbs, returns a % d. q may be a, d != 0 */
+uint64_t fib_limbs_divmod_1(uint64_t* q, const uint64_t* a, size_t n, uint64_t d);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* FAST_FIBONACCI_H_ */
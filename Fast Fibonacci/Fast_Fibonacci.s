@@ -1,75 +1,384 @@
+# Build the program:       as Fast_Fibonacci.s -o fib.o && ld fib.o -o fib
+# Link the kernels into C/C++ (declared in Fast_Fibonacci.h):
+#                           as --defsym FIB_LIBRARY=1 Fast_Fibonacci.s -o fib_kernels.o
+
+.ifndef FIB_LIBRARY
 .global _start
+.endif
+.global fastFib, fib_doubling
+.type fastFib, @function
+.type fib_doubling, @function
+.global fib_u64, fib_checked
+.type fib_u64, @function
+.type fib_checked, @function
+.global fib_mod, fib_mod_batch
+.type fib_mod, @function
+.type fib_mod_batch, @function
+.global fib_limbs_add, fib_limbs_sub, fib_limbs_addmul_1, fib_limbs_divmod_1
+.type fib_limbs_add, @function
+.type fib_limbs_sub, @function
+.type fib_limbs_addmul_1, @function
+.type fib_limbs_divmod_1, @function
 
 .section .data
 Array: .quad 0, 1, 1
 
-Request: .asciz "Enter a number: "
-Request_len: .quad Request_len - Request
+Request: .ascii "Enter a number: "
+.set REQUEST_LEN, . - Request
+
+Error: .ascii "illegal input\n"
+.set ERROR_LEN, . - Error
+.quad 0                     # slack: put_error copies 16 bytes.
+
+
+.section .rodata
+# "00" ... "99", for the itoa that writes two digits per division.
+Digit_pairs:
+.irp tens, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9
+.irp ones, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9
+.ascii "\tens\ones"
+.endr
+.endr
+
+# F(0) ... F(93), every Fibonacci number that fits in 64 bits, summed by the assembler.
+# Entry 94 is the saturated value that fib_u64 returns past the end.
+.balign 64
+Fib_table:
+.set FIB_A, 0
+.set FIB_B, 1
+.rept 94
+.quad FIB_A
+.set FIB_NEXT, FIB_A + FIB_B
+.set FIB_A, FIB_B
+.set FIB_B, FIB_NEXT
+.endr
+.quad 0xFFFFFFFFFFFFFFFF
 
-Error: .asciz "illegal input\n"
-Error_len: .quad Error_len - Error
 
+.set IN_SIZE, 1 << 20
+.set OUT_SIZE, 1 << 20
 
 .section .bss
-.lcomm number, 4
-.lcomm result, 8
+.lcomm In_buffer, IN_SIZE + 16      # slack: the atoi loads 8 bytes at a time.
+.lcomm Out_buffer, OUT_SIZE + 64    # slack: a line is copied 32 bytes at a time.
+.lcomm Termios, 64
+.lcomm Digits, 48
 
 
 .section .text
+.ifndef FIB_LIBRARY
+# Batch mode: every line of stdin holds one n, every line of stdout gets F(n),
+# or "illegal input" if the line isn't a number in [0, 93] (F(94) overflows 64 bits).
+# Empty lines (or a lone '\r') are skipped, a '\r' before the '\n' is allowed,
+# and so are leading zeros.
+# stdin is read in blocks of IN_SIZE and stdout written in blocks of OUT_SIZE, so a pipe
+# of millions of queries costs a few syscalls per megabyte. On a terminal the prompt
+# is shown & the answers are flushed after every read.
+#
+# Registers: rbx = flags (1: tty, 2: skipping a line longer than the buffer),
+# r12 = the next line, r13 = the end of the whole lines, r14 = the output position,
+# r15 = the bytes held in In_buffer.
 _start:
-    # Prologue
-    pushq %rbp
-    movq %rsp, %rbp
+    movl $16, %eax          # ioctl NR
+    xorl %edi, %edi         # STDIN
+    movl $0x5401, %esi      # TCGETS, fails unless stdin is a terminal
+    leaq Termios(%rip), %rdx
+    syscall
+
+    xorl %ebx, %ebx
+    testq %rax, %rax
+    jnz not_tty
+    orl $1, %ebx
 
-    # write an asking for a number
-    movq $1, %rax           # write NR
-    movq $1, %rdi           # write to STDOUT
-    leaq Request(%rip), %rsi     # buff to write
-    movq (Request_len), %rdx     # size to write
+not_tty:
+    leaq Out_buffer(%rip), %r14
+    xorl %r15d, %r15d
+
+read_more:
+    testl $1, %ebx
+    jz read_block
+
+    movl $1, %eax           # write NR
+    movl $1, %edi           # write to STDOUT
+    leaq Request(%rip), %rsi
+    movl $REQUEST_LEN, %edx
     syscall
 
-    # read a number
-    movq $0, %rax           # read NR
-    movq $0, %rdi           # read from STDIN
-    leaq number(%rip), %rsi     # read to 'number'
-    movq $2, %rdx               # read 2 char
+read_block:
+    xorl %eax, %eax         # read NR
+    xorl %edi, %edi         # read from STDIN
+    leaq In_buffer(%rip), %rsi
+    addq %r15, %rsi         # after the partial line of the last block
+    movl $IN_SIZE, %edx
+    subq %r15, %rdx
     syscall
 
-    movl (number), %edi     # mov n to rdi
+    testq %rax, %rax
+    jle end_of_input        # EOF (or an error, handled alike)
+    addq %rax, %r15
 
-    # check if input legal
-    cmpl $0, %edi
-    jge print_error         # jump greater-than-equal signed
-    cmpl $0x14, %edi
-    jl print_error          # jump less-than signed
+    # the block ends after its last '\n', the rest waits for the next read:
+    leaq In_buffer(%rip), %r12
+    leaq (%r12,%r15), %r13
 
-    call fastFib
-    movq %rax, (result)     # mov ret_val to result
-    
-    # print result
-    movq $1, %rax           # write NR
-    movq $1, %rdi           # write to STDOUT
-    leaq result(%rip), %rsi
-    movq $4, %rdx           # size of result
+find_last_line:
+    cmpq %r12, %r13
+    je no_whole_line
+    cmpb $'\n', -1(%r13)
+    je got_lines
+    subq $1, %r13
+    jmp find_last_line
+
+got_lines:
+    call parse_lines
+
+    leaq In_buffer(%rip), %rdi  # move the partial line to the front
+    movq %r13, %rsi
+    leaq (%rdi,%r15), %rcx
+    subq %r13, %rcx
+    movq %rcx, %r15
+    rep movsb
+
+    testl $1, %ebx
+    jz read_more
+    call flush
+    jmp read_more
+
+no_whole_line:
+    cmpq $IN_SIZE, %r15
+    jb read_more
+
+    orl $2, %ebx            # a line longer than the buffer: drop it up to its '\n'
+    xorl %r15d, %r15d
+    jmp read_more
+
+end_of_input:
+    testq %r15, %r15
+    jz last_skip
+
+    leaq In_buffer(%rip), %r12  # the last line has no '\n'
+    leaq (%r12,%r15), %r13
+    movb $'\n', (%r13)
+    addq $1, %r13
+    call parse_lines
+    jmp exit_ok
+
+last_skip:
+    testl $2, %ebx
+    jz exit_ok
+    call put_error
+
+exit_ok:
+    call flush
+    movl $60, %eax          # exit NR
+    xorl %edi, %edi         # exit value
     syscall
-    jmp end
 
-print_error:
-    movq $1, %rax           # write NR
-    movq $1, %rdi           # write to STDOUT
-    leaq Error(%rip), %rsi
-    movq (Error_len), %rdx
+
+# Answers the lines in [r12, r13). r13[-1] is a '\n'.
+parse_lines:
+    testl $2, %ebx
+    jz parse_line
+
+skip_long_line:
+    cmpb $'\n', (%r12)
+    je end_long_line
+    addq $1, %r12
+    jmp skip_long_line
+
+end_long_line:
+    addq $1, %r12
+    andl $~2, %ebx
+    call put_error
+
+parse_line:
+    cmpq %r13, %r12
+    jae end_parse
+
+    cmpb $'\n', (%r12)
+    je empty_line
+    cmpb $'\r', (%r12)      # a '\r' isn't the last char, so 1(%r12) is in the line.
+    jne skip_zeros
+    cmpb $'\n', 1(%r12)
+    jne skip_zeros
+    addq $1, %r12
+
+empty_line:
+    addq $1, %r12
+    jmp parse_line
+
+skip_zeros:                 # all but the last of the leading zeros, so 8 digits are left for the atoi.
+    cmpb $'0', (%r12)
+    jne parse_number
+    movzbl 1(%r12), %eax
+    subl $'0', %eax
+    cmpl $9, %eax
+    ja parse_number
+    addq $1, %r12
+    jmp skip_zeros
+
+parse_number:
+    # SWAR atoi: 8 chars in one register, the first char in the low byte.
+    # A byte is a digit iff its high nibble is 3 both before & after adding 6.
+    movq (%r12), %rax
+    movabsq $0xF0F0F0F0F0F0F0F0, %r8
+    movabsq $0x3030303030303030, %r9
+    movabsq $0x0606060606060606, %r10
+
+    movq %rax, %rcx
+    andq %r8, %rcx
+    xorq %r9, %rcx
+    leaq (%rax,%r10), %rdx  # a carry only leaves a non-digit, into the bytes after it.
+    andq %r8, %rdx
+    xorq %r9, %rdx
+    orq %rdx, %rcx          # nonzero bytes: the non-digits.
+    jz bad_line             # 8 digits or more.
+
+    bsfq %rcx, %rcx
+    andl $0x38, %ecx        # rcx = 8 * the number of digits.
+    jz bad_line             # no digit.
+
+    movl %ecx, %edx
+    shrl $3, %edx
+    addq %rdx, %r12         # r12 = after the digits.
+
+    negl %ecx
+    addl $64, %ecx
+    shlq %cl, %rax          # the digits to the high bytes, leading zeros below.
+
+    movabsq $0x0F0F0F0F0F0F0F0F, %rdx
+    andq %rdx, %rax
+    imulq $2561, %rax       # pairs of digits: 10 * 256 + 1.
+    shrq $8, %rax
+    movabsq $0x00FF00FF00FF00FF, %rdx
+    andq %rdx, %rax
+    imulq $6553601, %rax    # quads: 100 * 65536 + 1.
+    shrq $16, %rax
+    movabsq $0x0000FFFF0000FFFF, %rdx
+    andq %rdx, %rax
+    movabsq $42949672960001, %rdx   # all 8: 10000 * 2^32 + 1.
+    imulq %rdx, %rax
+    shrq $32, %rax
+
+    cmpb $'\r', (%r12)
+    jne check_line_end
+    addq $1, %r12
+
+check_line_end:
+    cmpb $'\n', (%r12)
+    jne bad_line
+    cmpq $93, %rax
+    ja bad_line
+
+    addq $1, %r12
+    leaq Fib_table(%rip), %rdx
+    movq (%rdx,%rax,8), %rax
+    call put_number
+    jmp parse_line
+
+bad_line:
+    cmpb $'\n', (%r12)
+    je end_bad_line
+    addq $1, %r12
+    jmp bad_line
+
+end_bad_line:
+    addq $1, %r12
+    call put_error
+    jmp parse_line
+
+end_parse:
+    ret
+
+
+# Appends rax in decimal & a '\n'. Two digits per step, x / 100 by a multiply.
+put_number:
+    leaq Digits+24(%rip), %rdi  # written backwards from here.
+    leaq Digit_pairs(%rip), %rsi
+    subq $1, %rdi
+    movb $'\n', (%rdi)
+
+itoa_loop:
+    cmpq $100, %rax
+    jb itoa_last
+
+    movq %rax, %r8
+    shrq $2, %rax
+    movabsq $0x28F5C28F5C28F5C3, %rdx
+    mulq %rdx
+    shrq $2, %rdx           # rdx = x / 100.
+    imulq $100, %rdx, %rax
+    subq %rax, %r8          # r8 = x % 100.
+    movzwl (%rsi,%r8,2), %ecx
+    subq $2, %rdi
+    movw %cx, (%rdi)
+    movq %rdx, %rax
+    jmp itoa_loop
+
+itoa_last:
+    cmpq $10, %rax
+    jb itoa_digit
+
+    movzwl (%rsi,%rax,2), %ecx
+    subq $2, %rdi
+    movw %cx, (%rdi)
+    jmp itoa_copy
+
+itoa_digit:
+    addl $'0', %eax
+    subq $1, %rdi
+    movb %al, (%rdi)
+
+itoa_copy:
+    leaq Digits+24(%rip), %rcx
+    subq %rdi, %rcx         # at most 21 bytes, copied as 32.
+    movdqu (%rdi), %xmm0
+    movdqu 16(%rdi), %xmm1
+    movdqu %xmm0, (%r14)
+    movdqu %xmm1, 16(%r14)
+    addq %rcx, %r14
+    jmp check_flush
+
+
+put_error:
+    movdqu Error(%rip), %xmm0
+    movdqu %xmm0, (%r14)
+    addq $ERROR_LEN, %r14
+
+check_flush:
+    leaq Out_buffer+OUT_SIZE(%rip), %rax
+    cmpq %rax, %r14
+    jae flush
+    ret
+
+
+# Writes Out_buffer up to r14, looping over short writes.
+flush:
+    leaq Out_buffer(%rip), %rsi
+
+flush_loop:
+    movq %r14, %rdx
+    subq %rsi, %rdx
+    jz end_flush
+
+    movl $1, %eax           # write NR
+    movl $1, %edi           # write to STDOUT
     syscall
 
-end:
-    # Epilogue
-    movq %rbp, %rsp
-    popq %rbp
+    testq %rax, %rax
+    jle write_failed
+    addq %rax, %rsi
+    jmp flush_loop
 
-    # exit
-    movq $60, %rax          # exit NR
-    movq $0, %rdi           # exit value
+end_flush:
+    leaq Out_buffer(%rip), %r14
+    ret
+
+write_failed:
+    movl $60, %eax          # exit NR
+    movl $1, %edi           # exit value
     syscall
+.endif
 
 
 fastFib:                    # receive n as a para.
@@ -79,26 +388,27 @@ fastFib:                    # receive n as a para.
     
     movl %edi, %esi         # rsi is n.
     movl $3, %ecx           # rcx is the index i.
+    leaq Array(%rip), %r9   # r9 = Array (RIP-relative, so it links into PIE).
+
+    movq $0, (%r9)          # Array = {F(0), F(1), F(2)}, whatever the last call left.
+    movq $1, 8(%r9)
+    movq $1, 16(%r9)
 
 loop:
     cmpl %ecx, %esi         # compare i with n.
-    ja end_loop             # if (i > n) jump to end_loop.
+    jb end_loop             # if (i > n) jump to end_loop.
     
-    movl %ecx, %edi
-    call calc_mod3               # mov i as a para to cala_mod3.
-    movq Array(,%eax,8), %r8     # r8 = *(eax*8 + Array) = Array[i % 3].
-
     leal -1(%ecx), %edi          # edi = i - 1.
     call calc_mod3               # mov (i - 1) as a para to cala_mod3.
-    addq Array(,%eax,8), %r8     # r8 += *(eax*8 + Array) = Array[(i - 1) % 3].
+    movq (%r9,%rax,8), %r8     # r8 = *(r9 + rax*8) = Array[(i - 1) % 3].
 
     leal -2(%ecx), %edi          # edi = i - 2.
     call calc_mod3               # mov (i - 2) as a para to cala_mod3.
-    addq Array(,%eax,8), %r8     # r8 += *(eax*8 + Array) = Array[(i - 2) % 3].
+    addq (%r9,%rax,8), %r8     # r8 += *(r9 + rax*8) = Array[(i - 2) % 3].
 
     movl %ecx, %edi
     call calc_mod3
-    movq %r8, Array(,%eax,8)     # Array[i % 3] = r8.
+    movq %r8, (%r9,%rax,8)     # Array[i % 3] = r8.
     
     inc %ecx
     jmp loop
@@ -106,7 +416,7 @@ end_loop:
 
     movl %esi, %edi              # mov n as a para to calc_mod3.
     call calc_mod3
-    movq Array(,%eax,8), %rax    # rax = Array[n % 3].
+    movq (%r9,%rax,8), %rax    # rax = Array[n % 3].
 
     # Epilogue
     leave                        # Equal to: movq %rbp, %rsp + popq %rbp
@@ -129,3 +439,519 @@ calc_mod3:                  # receive i as a para.
     leave
     ret
 
+
+# uint64_t fib_doubling(uint64_t n)  (System V ABI)
+# Fast doubling, O(log n):  F(2k) = F(k) * (2F(k+1) - F(k)),  F(2k+1) = F(k)^2 + F(k+1)^2.
+# The bits of n are read from the top. Exact for n <= 93, F(n) mod 2^64 above.
+# A leaf with no stack & no memory: every value stays in caller-saved registers.
+fib_doubling:               # receive n in rdi.
+    xorl %eax, %eax         # rax = a = F(k), k = 0.
+    movl $1, %edx           # rdx = b = F(k + 1).
+
+    testq %rdi, %rdi
+    jz end_doubling         # F(0) = 0.
+
+    bsrq %rdi, %rcx         # rcx = index of the top bit of n.
+
+doubling_loop:
+    leaq (%rdx,%rdx), %rsi  # rsi = 2b.
+    subq %rax, %rsi         # rsi = 2b - a.
+    imulq %rax, %rsi        # rsi = c = a * (2b - a) = F(2k).
+    imulq %rax, %rax        # rax = a^2.
+    imulq %rdx, %rdx        # rdx = b^2.
+    addq %rdx, %rax         # rax = d = a^2 + b^2 = F(2k + 1).
+
+    # bit clear: (a, b) = (c, d).  bit set: (a, b) = (d, c + d).  No branch:
+    leaq (%rsi,%rax), %r8   # r8 = c + d.
+    btq %rcx, %rdi          # CF = bit rcx of n.
+    movq %rax, %rdx         # b = d.
+    cmovcq %r8, %rdx        # b = c + d, if the bit is set.
+    cmovncq %rsi, %rax      # a = c, if the bit is clear.
+
+    subq $1, %rcx
+    jns doubling_loop       # until bit 0 was done.
+
+end_doubling:
+    ret
+.size fib_doubling, . - fib_doubling
+
+
+# uint64_t fib_u64(uint64_t n)  (System V ABI)
+# F(n) in one load from Fib_table. n > 93 saturates to 2^64 - 1, with a cmov & no branch.
+fib_u64:                    # receive n in rdi.
+    movl $94, %eax
+    cmpq %rax, %rdi
+    cmovbq %rdi, %rax       # rax = min(n, 94).
+    leaq Fib_table(%rip), %rdx
+    movq (%rdx,%rax,8), %rax
+    ret
+.size fib_u64, . - fib_u64
+
+
+# int fib_checked(uint64_t n, uint64_t* out)  (System V ABI)
+# Like fib_u64 into *out, and returns 1 if F(n) fits in 64 bits, 0 if it overflows.
+fib_checked:                # receive n in rdi, out in rsi.
+    xorl %eax, %eax
+    movl $94, %ecx
+    cmpq %rcx, %rdi
+    setb %al                # rax = n < 94.
+    cmovbq %rdi, %rcx
+    leaq Fib_table(%rip), %rdx
+    movq (%rdx,%rcx,8), %rdx
+    movq %rdx, (%rsi)
+    ret
+.size fib_checked, . - fib_checked
+
+
+# F(n) mod m: the same doubling, with every product reduced mod m.
+# The step macros keep m in rcx, m' in r10, a = F(k) in r8, b = F(k + 1) in r9,
+# n in rdi & the bit index in r11. They use rax, rdx, rbx, r12, rsi, r13 & r14.
+
+# rax = rax mod m, for rax < 2m where CF holds bit 64 of it:
+.macro FOLD dest
+    sbbq %rbx, %rbx         # rbx = -(bit 64).
+    movq %rax, %rdx
+    subq %rcx, %rdx         # rdx = rax - m, CF = rax < m.
+    adcq $0, %rbx           # rbx = 1 only if rax < m with no bit 64.
+    cmpq $1, %rbx
+    cmovneq %rdx, %rax
+    movq %rax, \dest
+.endm
+
+# The same for m < 2^63, where 2m fits and bit 64 is always clear: half the work.
+.macro FOLD_63 dest
+    movq %rax, %rdx
+    subq %rcx, %rdx
+    cmovncq %rdx, %rax
+    movq %rax, \dest
+.endm
+
+.macro ADD_MOD x, y, dest, fold=FOLD
+    movq \x, %rax
+    addq \y, %rax
+    \fold \dest
+.endm
+
+.macro SUB_MOD x, y, dest
+    movq \x, %rax
+    subq \y, %rax
+    leaq (%rax,%rcx), %rdx  # lea keeps the borrow in CF.
+    cmovcq %rdx, %rax
+    movq %rax, \dest
+.endm
+
+# Montgomery product x * y / 2^64 mod m, for odd m: one imul & two mulq, no divide.
+# t = (xy + qm) / 2^64 with q = xy * m' mod 2^64 is exact and below 2m.
+.macro MONT_MUL x, y, dest, fold=FOLD
+    movq \x, %rax
+    mulq \y                 # rdx:rax = xy.
+    movq %rax, %rbx
+    movq %rdx, %r12
+    imulq %r10, %rax        # q.
+    mulq %rcx               # rdx:rax = qm, its low limb cancels xy's.
+    addq %rbx, %rax
+    adcq %r12, %rdx         # rdx = t, CF = bit 64 of t.
+    movq %rdx, %rax
+    \fold \dest
+.endm
+
+# x * y mod m by divq, for any m. The quotient fits since x, y < m.
+.macro DIV_MUL x, y, dest, fold
+    movq \x, %rax
+    mulq \y
+    divq %rcx
+    movq %rdx, \dest
+.endm
+
+# m' = -1/m mod 2^64 by Newton (m is its own inverse mod 8, each round doubles
+# the right bits), and r9 = 2^64 mod m, which is 1 in Montgomery form.
+.macro MONT_SETUP
+    movq %rcx, %r10
+    .rept 5
+    movq %rcx, %rax
+    imulq %r10, %rax
+    movl $2, %edx
+    subq %rax, %rdx
+    imulq %rdx, %r10        # inv = inv * (2 - m * inv).
+    .endr
+    negq %r10
+    movl $1, %edx
+    xorl %eax, %eax
+    divq %rcx
+    movq %rdx, %r9
+.endm
+
+# (a, b) = (F(k), F(k + 1)) -> (F(2k), F(2k + 1)) or (F(2k + 1), F(2k + 2)) by bit r11 of n.
+# The three products depend only on a & b, so they overlap in the pipeline.
+.macro FIB_MOD_STEP mul, fold=FOLD
+    ADD_MOD %r9, %r9, %rsi, \fold
+    SUB_MOD %rsi, %r8, %rsi     # rsi = 2b - a.
+    \mul %r8, %rsi, %r13, \fold # r13 = c = F(2k).
+    \mul %r8, %r8, %r8, \fold   # a^2.
+    \mul %r9, %r9, %r9, \fold   # b^2.
+    ADD_MOD %r8, %r9, %r9, \fold        # r9 = d = F(2k + 1).
+    ADD_MOD %r13, %r9, %r14, \fold      # r14 = c + d.
+    movq %r13, %r8
+    btq %r11, %rdi
+    cmovcq %r9, %r8
+    cmovcq %r14, %r9
+.endm
+
+
+# uint64_t fib_mod(uint64_t n, uint64_t m)  (System V ABI)
+# F(n) mod m in O(log n) for any 64-bit n & m; m <= 1 gives 0.
+# Montgomery form for odd m, divq for even m; FOLD_63 when m < 2^63.
+fib_mod:                    # receive n in rdi, m in rsi.
+    xorl %eax, %eax
+    cmpq $1, %rsi
+    jbe end_fib_mod
+
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+
+    movq %rsi, %rcx
+    movq %rdi, %rax
+    orq $1, %rax
+    bsrq %rax, %r11         # r11 = index of the top bit of n (0 for n = 0).
+    xorl %r8d, %r8d         # a = F(0).
+
+    testb $1, %cl
+    jz fib_mod_div
+
+    MONT_SETUP              # b = F(1), in Montgomery form.
+
+    testq %rcx, %rcx
+    js mod_mont_loop
+
+mod_mont_63_loop:
+    FIB_MOD_STEP MONT_MUL, FOLD_63
+    subq $1, %r11
+    jns mod_mont_63_loop
+    jmp end_mod_mont
+
+mod_mont_loop:
+    FIB_MOD_STEP MONT_MUL
+    subq $1, %r11
+    jns mod_mont_loop
+
+end_mod_mont:
+    movl $1, %esi
+    MONT_MUL %r8, %rsi, %rax    # out of Montgomery form.
+    jmp pop_fib_mod
+
+fib_mod_div:
+    movl $1, %r9d           # b = F(1).
+
+mod_div_loop:
+    FIB_MOD_STEP DIV_MUL
+    subq $1, %r11
+    jns mod_div_loop
+
+    movq %r8, %rax
+
+pop_fib_mod:
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+
+end_fib_mod:
+    ret
+.size fib_mod, . - fib_mod
+
+
+# The lane forms of the step macros, for m < 2^63: m, m' & n are memory operands,
+# so a & b of every lane stay in registers. They use rax, rdx, rbx & rcx.
+
+# rax = rax mod m for rax < 2m.
+.macro LANE_FOLD m
+    movq %rax, %rdx
+    subq \m, %rdx
+    cmovncq %rdx, %rax
+.endm
+
+.macro LANE_MUL x, y, dest, m, mp
+    movq \x, %rax
+    mulq \y                 # rdx:rax = xy.
+    movq %rax, %rbx
+    movq %rdx, %rcx
+    imulq \mp, %rax         # q.
+    mulq \m                 # rdx:rax = qm.
+    addq %rbx, %rax
+    adcq %rcx, %rdx         # t < 2m < 2^64, no bit 64.
+    movq %rdx, %rax
+    LANE_FOLD \m
+    movq %rax, \dest
+.endm
+
+# (a, b) -> the next pair by bit rbp of n, as FIB_MOD_STEP. rsi & rdi are the temporaries.
+.macro LANE_STEP a, b, lane
+    movq \b, %rax
+    addq \b, %rax
+    LANE_FOLD \lane*48+8(%rsp)     # rax = 2b.
+    movq %rax, %rsi
+    addq \lane*48+8(%rsp), %rsi    # rsi = 2b + m - a, below 2^64 since m < 2^63.
+    subq \a, %rsi
+    subq \a, %rax
+    cmovcq %rsi, %rax
+    movq %rax, %rsi                 # rsi = 2b - a.
+    LANE_MUL \a, %rsi, %rsi, \lane*48+8(%rsp), \lane*48+16(%rsp)     # rsi = c = F(2k).
+    LANE_MUL \a, \a, \a, \lane*48+8(%rsp), \lane*48+16(%rsp)
+    LANE_MUL \b, \b, \b, \lane*48+8(%rsp), \lane*48+16(%rsp)
+    movq \a, %rax
+    addq \b, %rax
+    LANE_FOLD \lane*48+8(%rsp)
+    movq %rax, \b                  # b = d = F(2k + 1).
+    addq %rsi, %rax
+    LANE_FOLD \lane*48+8(%rsp)
+    movq %rax, %rdi                 # rdi = c + d.
+    movq %rsi, \a
+    movq \lane*48(%rsp), %rax
+    btq %rbp, %rax
+    cmovcq \b, \a
+    cmovcq %rdi, \b
+.endm
+
+# out[index of the lane] = a out of Montgomery form, with rsi = 1 & rdi = out.
+.macro LANE_OUT a, lane
+    LANE_MUL \a, %rsi, %rax, \lane*48+8(%rsp), \lane*48+16(%rsp)
+    movq \lane*48+32(%rsp), %rdx
+    movq %rax, (%rdi,%rdx,8)
+.endm
+
+
+# void fib_mod_batch(const uint64_t* n, const uint64_t* m, uint64_t* out, size_t count)
+# out[i] = fib_mod(n[i], m[i]). out may be n or m.
+# The queries with odd m < 2^63 are gathered four at a time into interleaved lanes:
+# the steps of the four dependency chains are issued back to back, so one lane's
+# mulq latency hides behind the others. a & b of the lanes are in r8-r15 for the
+# whole loop; n, m, m', the first b & the query's index wait on the stack (48 bytes a lane)
+# and are read as memory operands, off the dependency chains.
+# The other queries go through fib_mod (with the long FOLD a lane is bound by
+# issue width, not latency, and gains nothing).
+fib_mod_batch:              # rdi = n, rsi = m, rdx = out, rcx = count.
+    pushq %rbx
+    pushq %rbp
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $232, %rsp         # 4 lanes, then n, m, out, count & i at 192.
+
+    movq %rdi, 192(%rsp)
+    movq %rsi, 200(%rsp)
+    movq %rdx, 208(%rsp)
+    movq %rcx, 216(%rsp)
+    xorl %r15d, %r15d       # r15 = i, the next query.
+    xorl %r14d, %r14d       # r14 = lanes filled.
+
+batch_next:
+    cmpq 216(%rsp), %r15
+    je batch_flush
+
+    # lanes need odd moduli in (1, 2^63):
+    movq 200(%rsp), %rcx
+    movq (%rcx,%r15,8), %rcx
+    testb $1, %cl
+    jz batch_single
+    cmpq $1, %rcx
+    je batch_single
+    testq %rcx, %rcx
+    js batch_single
+
+    imulq $48, %r14, %rbx   # rbx = the free lane.
+    movq 192(%rsp), %rdi
+    movq (%rdi,%r15,8), %rdi
+    movq %rdi, (%rsp,%rbx)
+    movq %rcx, 8(%rsp,%rbx)
+    MONT_SETUP
+    movq %r10, 16(%rsp,%rbx)
+    movq %r9, 24(%rsp,%rbx)
+    movq %r15, 32(%rsp,%rbx)
+
+    addq $1, %r15
+    addq $1, %r14
+    cmpq $4, %r14
+    jb batch_next
+
+    movq %r15, 224(%rsp)    # r15 is a lane now.
+
+    movq 0(%rsp), %rax      # the lanes step together, over the top bit of any n.
+    orq 48(%rsp), %rax
+    orq 96(%rsp), %rax
+    orq 144(%rsp), %rax
+    orq $1, %rax
+    bsrq %rax, %rbp
+
+    xorl %r8d, %r8d         # a = F(0) & b = F(1) in Montgomery form, in every lane.
+    movq 24(%rsp), %r9
+    xorl %r10d, %r10d
+    movq 72(%rsp), %r11
+    xorl %r12d, %r12d
+    movq 120(%rsp), %r13
+    xorl %r14d, %r14d
+    movq 168(%rsp), %r15
+
+batch_step:
+    LANE_STEP %r8, %r9, 0
+    LANE_STEP %r10, %r11, 1
+    LANE_STEP %r12, %r13, 2
+    LANE_STEP %r14, %r15, 3
+
+    subq $1, %rbp
+    jns batch_step
+
+    movq 208(%rsp), %rdi
+    movl $1, %esi
+    LANE_OUT %r8, 0
+    LANE_OUT %r10, 1
+    LANE_OUT %r12, 2
+    LANE_OUT %r14, 3
+
+    movq 224(%rsp), %r15
+    xorl %r14d, %r14d
+    jmp batch_next
+
+batch_single:
+    movq 192(%rsp), %rdi
+    movq (%rdi,%r15,8), %rdi
+    movq %rcx, %rsi
+    call fib_mod
+    movq 208(%rsp), %rdx
+    movq %rax, (%rdx,%r15,8)
+    addq $1, %r15
+    jmp batch_next
+
+batch_flush:                # fewer than 4 lanes are left, one by one.
+    testq %r14, %r14
+    jz end_batch
+
+    subq $1, %r14
+    imulq $48, %r14, %rbx
+    movq (%rsp,%rbx), %rdi
+    movq 8(%rsp,%rbx), %rsi
+    call fib_mod
+    movq 208(%rsp), %rdx
+    movq 32(%rsp,%rbx), %rcx
+    movq %rax, (%rdx,%rcx,8)
+    jmp batch_flush
+
+end_batch:
+    addq $232, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbp
+    popq %rbx
+    ret
+.size fib_mod_batch, . - fib_mod_batch
+
+
+# Limb kernels of the big-integer engine (Fast_Fibonacci_Big.h).
+# A number is an array of 64-bit limbs, the least significant first.
+
+# uint64_t fib_limbs_add(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n)
+# r = a + b over n limbs. Returns the carry out. r may be a or b.
+fib_limbs_add:              # rdi = r, rsi = a, rdx = b, rcx = n.
+    xorl %eax, %eax
+    testq %rcx, %rcx
+    jz end_limbs_add
+
+    xorl %r8d, %r8d         # r8 = i. The xor clears CF too.
+
+limbs_add_loop:
+    movq (%rsi,%r8,8), %rax
+    adcq (%rdx,%r8,8), %rax # rax = a[i] + b[i] + CF.
+    movq %rax, (%rdi,%r8,8)
+    incq %r8                # inc & dec keep CF for the next adc.
+    decq %rcx
+    jnz limbs_add_loop
+
+    setc %al
+    movzbl %al, %eax        # rax = the carry out.
+
+end_limbs_add:
+    ret
+.size fib_limbs_add, . - fib_limbs_add
+
+
+# uint64_t fib_limbs_sub(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n)
+# r = a - b over n limbs. Returns the borrow out. r may be a or b.
+fib_limbs_sub:              # rdi = r, rsi = a, rdx = b, rcx = n.
+    xorl %eax, %eax
+    testq %rcx, %rcx
+    jz end_limbs_sub
+
+    xorl %r8d, %r8d         # r8 = i. The xor clears CF too.
+
+limbs_sub_loop:
+    movq (%rsi,%r8,8), %rax
+    sbbq (%rdx,%r8,8), %rax # rax = a[i] - b[i] - CF.
+    movq %rax, (%rdi,%r8,8)
+    incq %r8
+    decq %rcx
+    jnz limbs_sub_loop
+
+    setc %al
+    movzbl %al, %eax        # rax = the borrow out.
+
+end_limbs_sub:
+    ret
+.size fib_limbs_sub, . - fib_limbs_sub
+
+
+# uint64_t fib_limbs_addmul_1(uint64_t* r, const uint64_t* a, size_t n, uint64_t m)
+# r += a * m over n limbs. Returns the limb carried out of r[n - 1].
+# a[i] * m + carry + r[i] fits in 128 bits, so one mulq & two adc per limb.
+fib_limbs_addmul_1:         # rdi = r, rsi = a, rdx = n, rcx = m.
+    movq %rdx, %r10         # r10 = n, mulq takes rdx.
+    xorl %r9d, %r9d         # r9 = the carry limb.
+    xorl %r8d, %r8d         # r8 = i.
+    testq %r10, %r10
+    jz end_limbs_addmul_1
+
+limbs_addmul_1_loop:
+    movq (%rsi,%r8,8), %rax
+    mulq %rcx               # rdx:rax = a[i] * m.
+    addq %r9, %rax
+    adcq $0, %rdx           # += carry.
+    addq %rax, (%rdi,%r8,8)
+    adcq $0, %rdx           # += r[i].
+    movq %rdx, %r9
+    incq %r8
+    cmpq %r10, %r8
+    jb limbs_addmul_1_loop
+
+end_limbs_addmul_1:
+    movq %r9, %rax
+    ret
+.size fib_limbs_addmul_1, . - fib_limbs_addmul_1
+
+
+# uint64_t fib_limbs_divmod_1(uint64_t* q, const uint64_t* a, size_t n, uint64_t d)
+# q = a / d over n limbs, from the top limb down. Returns a % d. q may be a, d != 0.
+# The remainder is below d, so divq never overflows.
+fib_limbs_divmod_1:         # rdi = q, rsi = a, rdx = n, rcx = d.
+    movq %rdx, %r8          # r8 = i, from n down to 1.
+    xorl %edx, %edx         # rdx = the remainder.
+    testq %r8, %r8
+    jz end_limbs_divmod_1
+
+limbs_divmod_1_loop:
+    movq -8(%rsi,%r8,8), %rax
+    divq %rcx               # rax = (rdx:rax) / d, rdx = (rdx:rax) % d.
+    movq %rax, -8(%rdi,%r8,8)
+    decq %r8
+    jnz limbs_divmod_1_loop
+
+end_limbs_divmod_1:
+    movq %rdx, %rax
+    ret
+.size fib_limbs_divmod_1, . - fib_limbs_divmod_1
+
+
+# No executable stack is needed when linked with C/C++:
+.section .note.GNU-stack, "", @progbits
@@ -0,0 +1,571 @@
+#ifndef FAST_FIBONACCI_BIG_H_
+#define FAST_FIBONACCI_BIG_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Fast_Fibonacci.h"
+
+
+/*
+ *  Exact F(n) for big n (C++17), over the limb kernels of Fast_Fibonacci.s.
+ *
+ *  fib_big runs fast doubling on big integers:
+ *      F(2k)     = F(k) * (2F(k + 1) - F(k))
+ *      F(2k + 1) = F(k)^2 + F(k + 1)^2
+ *  so the cost is that of the products at the last few bits of n.
+ *  A product picks its algorithm by the size of its operands:
+ *      schoolbook (fib_limbs_addmul_1) -> Karatsuba -> NTT modulo 2^64 - 2^32 + 1.
+ *  The three products of a doubling step are independent and run on their own threads,
+ *  and so do the two forward transforms of an NTT product, once the operands are big
+ *  enough to pay for a thread (and the machine has more than one core).
+ *
+ *      fib_limbs f = fib_big(10000000);         // 6.9 million bits
+ *      std::string tail = fib_big_hex(f);
+ *
+ *  Link with the kernels:  as --defsym FIB_LIBRARY=1 Fast_Fibonacci.s -o fib_kernels.o
+ */
+
+/* A natural number in 64-bit limbs, the least significant first, no leading zero limbs (0 is empty) */
+using fib_limbs = std::vector<uint64_t>;
+
+fib_limbs fib_big(uint64_t n);
+
+/* Product of two numbers, by the same dispatch fib_big uses */
+fib_limbs fib_big_mul(const fib_limbs& a, const fib_limbs& b);
+
+size_t fib_big_bits(const fib_limbs& x);
+std::string fib_big_hex(const fib_limbs& x);
+
+/* O(size^2): divides by 10^19 once per 19 digits. Fine for test vectors, slow for F(10^7) */
+std::string fib_big_decimal(fib_limbs x);
+
+/* x mod m, m != 0. A cheap checksum of a huge F(n) */
+uint64_t fib_big_mod(const fib_limbs& x, uint64_t m);
+
+
+namespace fib_big_detail {
+
+constexpr size_t karatsuba_limbs = 32;      // smaller operands: schoolbook
+constexpr size_t ntt_limbs = 1536;          // bigger operands: NTT
+constexpr size_t parallel_limbs = 8192;     // bigger operands: a thread per product
+
+/* The NTT prime 2^64 - 2^32 + 1 has 2^32-th roots of unity, and 7 generates its group */
+constexpr uint64_t prime = 0xFFFFFFFF00000001ull;
+constexpr uint64_t epsilon = 0xFFFFFFFFull;     // 2^64 mod prime
+constexpr uint64_t generator = 7;
+
+/* __extension__ keeps -Wpedantic quiet about the GCC/Clang 128-bit type */
+__extension__ typedef unsigned __int128 fib_u128;
+
+
+inline bool
+parallel(size_t limbs){
+    return limbs >= parallel_limbs && std::thread::hardware_concurrency() > 1;
+}
+
+
+inline void
+trim(fib_limbs& x){
+
+    while(!x.empty() && x.back() == 0)
+        x.pop_back();
+}
+
+
+inline fib_limbs
+slice(const fib_limbs& x, size_t from, size_t to){
+
+    from = std::min(from, x.size());
+    to = std::min(to, x.size());
+
+    fib_limbs part(x.begin() + from, x.begin() + to);
+    trim(part);
+
+    return part;
+}
+
+
+/* x += y * 2^(64 * shift) */
+inline void
+addShifted(fib_limbs& x, const fib_limbs& y, size_t shift){
+
+    if(y.empty())
+        return;
+
+    if(x.size() < y.size() + shift)
+        x.resize(y.size() + shift, 0);
+
+    uint64_t carry = fib_limbs_add(x.data() + shift, x.data() + shift, y.data(), y.size());
+
+    for(size_t i = y.size() + shift; carry; i++){
+
+        if(i == x.size())
+            x.push_back(0);
+
+        carry = (++x[i] == 0);
+    }
+}
+
+
+/* x -= y, where x >= y */
+inline void
+subInPlace(fib_limbs& x, const fib_limbs& y){
+
+    uint64_t borrow = fib_limbs_sub(x.data(), x.data(), y.data(), y.size());
+
+    for(size_t i = y.size(); borrow; i++)
+        borrow = (x[i]-- == 0);
+
+    trim(x);
+}
+
+
+inline fib_limbs
+add(const fib_limbs& a, const fib_limbs& b){
+
+    fib_limbs sum = a;
+    addShifted(sum, b, 0);
+
+    return sum;
+}
+
+
+/*   ***   Schoolbook & Karatsuba   ***   */
+
+/* One fib_limbs_addmul_1 pass per limb of the shorter operand */
+inline fib_limbs
+mulSchool(const fib_limbs& a, const fib_limbs& b){
+
+    const fib_limbs& lng = a.size() >= b.size() ? a : b;
+    const fib_limbs& shrt = a.size() >= b.size() ? b : a;
+
+    fib_limbs prod(a.size() + b.size(), 0);
+
+    for(size_t j = 0; j < shrt.size(); j++)
+        prod[j + lng.size()] = fib_limbs_addmul_1(prod.data() + j, lng.data(), lng.size(), shrt[j]);
+
+    trim(prod);
+
+    return prod;
+}
+
+
+fib_limbs mul(const fib_limbs& a, const fib_limbs& b);
+
+
+/*
+ *  a = a1 * B^m + a0 and b = b1 * B^m + b0, then
+ *  a * b = z2 * B^2m + z1 * B^m + z0, where z1 = (a0 + a1)(b0 + b1) - z0 - z2.
+ *  If b is too short to split, only a is split.
+ */
+inline fib_limbs
+mulKaratsuba(const fib_limbs& a, const fib_limbs& b){
+
+    if(a.size() < b.size())
+        return mulKaratsuba(b, a);
+
+    if(b.size() < karatsuba_limbs)
+        return mulSchool(a, b);
+
+    bool square = &a == &b;
+    size_t m = (a.size() + 1) / 2;
+
+    fib_limbs a0 = slice(a, 0, m), a1 = slice(a, m, a.size());
+
+    if(b.size() <= m){
+
+        fib_limbs prod = mul(a0, b);
+        addShifted(prod, mul(a1, b), m);
+
+        return prod;
+    }
+
+    fib_limbs z0, z1, z2;
+
+    if(square){
+
+        fib_limbs sum = add(a0, a1);
+
+        z0 = mul(a0, a0);
+        z2 = mul(a1, a1);
+        z1 = mul(sum, sum);
+    }
+    else{
+
+        fib_limbs b0 = slice(b, 0, m), b1 = slice(b, m, b.size());
+
+        z0 = mul(a0, b0);
+        z2 = mul(a1, b1);
+        z1 = mul(add(a0, a1), add(b0, b1));
+    }
+
+    subInPlace(z1, z0);
+    subInPlace(z1, z2);
+
+    fib_limbs prod = std::move(z0);
+    addShifted(prod, z1, m);
+    addShifted(prod, z2, 2 * m);
+
+    return prod;
+}
+
+
+/*   ***   NTT   ***   */
+
+/* x mod prime, from 2^64 = 2^32 - 1 and 2^96 = -1 (mod prime) */
+inline uint64_t
+reduce(fib_u128 x){
+
+    uint64_t lo = uint64_t(x);
+    uint64_t hi = uint64_t(x >> 64);
+    uint64_t hi_hi = hi >> 32, hi_lo = hi & epsilon;
+
+    uint64_t t0 = lo - hi_hi;
+    if(lo < hi_hi)
+        t0 -= epsilon;
+
+    uint64_t t1 = hi_lo * epsilon;
+    uint64_t sum = t0 + t1;
+    if(sum < t1)
+        sum += epsilon;
+
+    return sum >= prime ? sum - prime : sum;
+}
+
+
+inline uint64_t
+mulMod(uint64_t a, uint64_t b){
+    return reduce(fib_u128(a) * b);
+}
+
+inline uint64_t
+addMod(uint64_t a, uint64_t b){
+
+    uint64_t sum = a + b;
+    if(sum < a)
+        sum += epsilon;
+
+    return sum >= prime ? sum - prime : sum;
+}
+
+inline uint64_t
+subMod(uint64_t a, uint64_t b){
+    return a >= b ? a - b : a + (prime - b);
+}
+
+inline uint64_t
+powMod(uint64_t base, uint64_t exp){
+
+    uint64_t result = 1;
+
+    for(; exp; exp >>= 1){
+
+        if(exp & 1)
+            result = mulMod(result, base);
+
+        base = mulMod(base, base);
+    }
+
+    return result;
+}
+
+
+/* In place, iterative radix-2. x.size() is a power of 2 */
+inline void
+transform(std::vector<uint64_t>& x, bool inverse){
+
+    size_t n = x.size();
+
+    for(size_t i = 1, j = 0; i < n; i++){
+
+        size_t bit = n >> 1;
+        for(; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+
+        if(i < j)
+            std::swap(x[i], x[j]);
+    }
+
+    std::vector<uint64_t> twiddles(n / 2);
+
+    for(size_t len = 2; len <= n; len <<= 1){
+
+        size_t half = len / 2;
+        uint64_t w = powMod(generator, (prime - 1) / len);
+
+        if(inverse)
+            w = powMod(w, prime - 2);
+
+        twiddles[0] = 1;
+        for(size_t j = 1; j < half; j++)
+            twiddles[j] = mulMod(twiddles[j - 1], w);
+
+        for(size_t i = 0; i < n; i += len){
+
+            for(size_t j = 0; j < half; j++){
+
+                uint64_t u = x[i + j];
+                uint64_t v = mulMod(x[i + j + half], twiddles[j]);
+
+                x[i + j] = addMod(u, v);
+                x[i + j + half] = subMod(u, v);
+            }
+        }
+    }
+
+    if(inverse){
+
+        uint64_t n_inv = powMod(n % prime, prime - 2);
+
+        for(uint64_t& coef : x)
+            coef = mulMod(coef, n_inv);
+    }
+}
+
+
+/* The limbs as 16-bit digits, transformed */
+inline std::vector<uint64_t>
+forward(const fib_limbs& x, size_t n){
+
+    std::vector<uint64_t> digits(n, 0);
+
+    for(size_t i = 0; i < x.size(); i++){
+
+        for(size_t k = 0; k < 4; k++)
+            digits[4 * i + k] = (x[i] >> (16 * k)) & 0xFFFF;
+    }
+
+    transform(digits, false);
+
+    return digits;
+}
+
+
+/*
+ *  16-bit digits keep every coefficient of the convolution exact:
+ *  at most min(digits) * (2^16 - 1)^2 < prime while the shorter operand has under 2^30 limbs.
+ */
+inline fib_limbs
+mulNTT(const fib_limbs& a, const fib_limbs& b){
+
+    size_t digits = 4 * (a.size() + b.size());
+    size_t n = 1;
+
+    while(n < digits)
+        n <<= 1;
+
+    std::vector<uint64_t> fa, fb;
+
+    if(&a == &b)
+        fa = forward(a, n);
+
+    else if(parallel(std::min(a.size(), b.size()))){
+
+        auto other = std::async(std::launch::async, forward, std::cref(b), n);
+        fa = forward(a, n);
+        fb = other.get();
+    }
+    else{
+
+        fa = forward(a, n);
+        fb = forward(b, n);
+    }
+
+    const std::vector<uint64_t>& gb = (&a == &b) ? fa : fb;
+
+    for(size_t i = 0; i < n; i++)
+        fa[i] = mulMod(fa[i], gb[i]);
+
+    transform(fa, true);
+
+    // carry the coefficients (under 2^52) back into 16-bit digits:
+    fib_limbs prod(a.size() + b.size(), 0);
+    uint64_t carry = 0;
+
+    for(size_t i = 0; i < digits; i++){
+
+        carry += fa[i];
+        prod[i / 4] |= (carry & 0xFFFF) << (16 * (i % 4));
+        carry >>= 16;
+    }
+
+    trim(prod);
+
+    return prod;
+}
+
+
+inline fib_limbs
+mul(const fib_limbs& a, const fib_limbs& b){
+
+    if(a.empty() || b.empty())
+        return fib_limbs();
+
+    if(std::min(a.size(), b.size()) < ntt_limbs)
+        return mulKaratsuba(a, b);
+
+    return mulNTT(a, b);
+}
+
+} // namespace fib_big_detail
+
+
+/*   ***   Operations   ***   */
+
+/* Scans n from its top bit, with (a, b) = (F(k), F(k + 1)) for the bits scanned so far */
+inline fib_limbs
+fib_big(uint64_t n){
+
+    using namespace fib_big_detail;
+
+    if(n == 0)
+        return fib_limbs();
+
+    fib_limbs a, b{1};
+
+    for(int bit = 63 - __builtin_clzll(n); bit >= 0; bit--){
+
+        bool odd = (n >> bit) & 1;
+
+        fib_limbs t = b;
+        addShifted(t, b, 0);
+        subInPlace(t, a);           // 2F(k + 1) - F(k)
+
+        // the last bit needs only F(n):
+        if(bit == 0){
+
+            if(!odd)
+                return mul(a, t);
+
+            fib_limbs sum = mul(a, a);
+            addShifted(sum, mul(b, b), 0);
+
+            return sum;
+        }
+
+        fib_limbs even, a2, b2;
+
+        if(parallel(a.size())){
+
+            auto even_job = std::async(std::launch::async, [&]{ return mul(a, t); });
+            auto a2_job = std::async(std::launch::async, [&]{ return mul(a, a); });
+
+            b2 = mul(b, b);
+            even = even_job.get();
+            a2 = a2_job.get();
+        }
+        else{
+
+            even = mul(a, t);
+            a2 = mul(a, a);
+            b2 = mul(b, b);
+        }
+
+        fib_limbs sum = std::move(a2);      // F(2k + 1)
+        addShifted(sum, b2, 0);
+
+        if(odd){
+
+            addShifted(even, sum, 0);       // F(2k + 2)
+            a = std::move(sum);
+            b = std::move(even);
+        }
+        else{
+
+            a = std::move(even);
+            b = std::move(sum);
+        }
+    }
+
+    return a;
+}
+
+
+inline fib_limbs
+fib_big_mul(const fib_limbs& a, const fib_limbs& b){
+    return fib_big_detail::mul(a, b);
+}
+
+
+inline size_t
+fib_big_bits(const fib_limbs& x){
+
+    if(x.empty())
+        return 0;
+
+    return 64 * x.size() - __builtin_clzll(x.back());
+}
+
+
+inline std::string
+fib_big_hex(const fib_limbs& x){
+
+    if(x.empty())
+        return "0";
+
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%llx", (unsigned long long)x.back());
+
+    std::string hex = buf;
+    hex.reserve(16 * x.size());
+
+    for(size_t i = x.size() - 1; i > 0; i--){
+
+        std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)x[i - 1]);
+        hex += buf;
+    }
+
+    return hex;
+}
+
+
+inline std::string
+fib_big_decimal(fib_limbs x){
+
+    const uint64_t chunk = 10000000000000000000ull;      // 10^19
+    std::vector<uint64_t> chunks;
+
+    while(!x.empty()){
+
+        chunks.push_back(fib_limbs_divmod_1(x.data(), x.data(), x.size(), chunk));
+        fib_big_detail::trim(x);
+    }
+
+    if(chunks.empty())
+        return "0";
+
+    char buf[21];
+    std::snprintf(buf, sizeof(buf), "%llu", (unsigned long long)chunks.back());
+
+    std::string dec = buf;
+    dec.reserve(19 * chunks.size());
+
+    for(size_t i = chunks.size() - 1; i > 0; i--){
+
+        std::snprintf(buf, sizeof(buf), "%019llu", (unsigned long long)chunks[i - 1]);
+        dec += buf;
+    }
+
+    return dec;
+}
+
+
+inline uint64_t
+fib_big_mod(const fib_limbs& x, uint64_t m){
+
+    fib_limbs quotient(x.size());
+
+    return fib_limbs_divmod_1(quotient.data(), x.data(), x.size(), m);
+}
+
+
+#endif /* FAST_FIBONACCI_BIG_H_ */
@@ -0,0 +1,65 @@
+#ifndef FAST_FIBONACCI_TABLE_H_
+#define FAST_FIBONACCI_TABLE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+/*
+ *  Every Fibonacci number that fits in 64 bits, computed by the compiler (C++17).
+ *  The same table as Fib_table in Fast_Fibonacci.s, for code that wants F(n)
+ *  in a constant expression or inlined without a call:
+ *
+ *      static_assert(fib_constexpr::fib_u64(10) == 55);
+ *
+ *  The names live in a namespace, so this header and Fast_Fibonacci.h (whose
+ *  fib_u64 & fib_checked are the asm ones) can be included together.
+ */
+
+namespace fib_constexpr {
+
+constexpr size_t fib_count = 94;        // F(93) < 2^64 <= F(94)
+
+
+/* F(0) ... F(93), then UINT64_MAX: the value saturated past the end */
+constexpr std::array<uint64_t, fib_count + 1>
+makeTable(){
+
+    std::array<uint64_t, fib_count + 1> table{};
+    table[1] = 1;
+
+    for(size_t i = 2; i < fib_count; i++)
+        table[i] = table[i - 1] + table[i - 2];
+
+    table[fib_count] = UINT64_MAX;
+
+    return table;
+}
+
+inline constexpr std::array<uint64_t, fib_count + 1> fib_table = makeTable();
+
+static_assert(fib_table[fib_count - 1] == 12200160415121876738ull, "F(93)");
+static_assert(fib_table[fib_count - 1] > UINT64_MAX - fib_table[fib_count - 2], "F(94) overflows");
+
+
+/* F(n) in one load. n > 93 saturates to UINT64_MAX; the clamp compiles to a cmov */
+constexpr uint64_t
+fib_u64(uint64_t n){
+    return fib_table[n < fib_count ? n : fib_count];
+}
+
+
+/* out = fib_u64(n). Returns false if F(n) overflows 64 bits (n > 93) */
+constexpr bool
+fib_checked(uint64_t n, uint64_t& out){
+
+    out = fib_u64(n);
+
+    return n < fib_count;
+}
+
+} // namespace fib_constexpr
+
+
+#endif /* FAST_FIBONACCI_TABLE_H_ */
@@ -0,0 +1,312 @@
+/*
+ *  Cycles per call of every F(n) kernel in this directory, across n.
+ *
+ *      fastFib         asm, the program's O(n) loop (a div per array index)
+ *      iterative       C++, the textbook O(n) loop
+ *      fib_doubling    asm, fast doubling in registers, O(log(n))
+ *      fib_u64         asm table, one load
+ *      constexpr       Fast_Fibonacci_Table.h, inlined
+ *      fib_mod         asm, F(n) mod m: odd m (Montgomery) & even m (divq)
+ *      fib_mod_batch   asm, the same in lanes, per query
+ *      fib_big         Fast_Fibonacci_Big.h, the exact F(n)
+ *
+ *  Every kernel is checked against the table (or fib_big) before it is timed.
+ *  A sample is a run of calls between two TSC reads: lfence; rdtsc; lfence before,
+ *  rdtscp; lfence after, so the calls can't drift out of the window. Each kernel gets
+ *  a warmup, then the calls per sample grow until a sample is long against the timer,
+ *  and the samples continue up to a time budget. The timer's own cost is subtracted.
+ *
+ *  One line per (kernel, n): median, p99 & min cycles per call, and the median in ns
+ *  from the measured TSC rate. CSV by default, JSON with --json, so two builds can be diffed.
+ *
+ *  Build & run:
+ *      as --defsym FIB_LIBRARY=1 Fast_Fibonacci.s -o fib_kernels.o
+ *      g++ -std=c++17 -O2 fib_bench.cpp fib_kernels.o -pthread -o fib_bench
+ *      ./fib_bench > before.csv
+ *      ./fib_bench --json > results.json
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <x86intrin.h>
+
+#include "Fast_Fibonacci.h"
+#include "Fast_Fibonacci_Big.h"
+#include "Fast_Fibonacci_Table.h"
+
+
+struct Result {
+    std::string kernel;
+    uint64_t n;
+    size_t calls;           // per sample
+    size_t samples;
+    double median, p99, min;
+};
+
+
+inline uint64_t
+tscBegin(){
+
+    _mm_lfence();
+    uint64_t tsc = __rdtsc();
+    _mm_lfence();
+
+    return tsc;
+}
+
+inline uint64_t
+tscEnd(){
+
+    unsigned aux;
+    uint64_t tsc = __rdtscp(&aux);
+    _mm_lfence();
+
+    return tsc;
+}
+
+
+/* The compiler can't see through these: n isn't a constant, the result isn't dead */
+inline uint64_t
+opaque(uint64_t x){
+
+    asm volatile("" : "+r"(x));
+    return x;
+}
+
+template <typename T>
+inline void
+keep(const T& value){
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+
+double
+timerOverhead(){
+
+    std::vector<uint64_t> samples(10001);
+
+    for(uint64_t& sample : samples){
+
+        uint64_t start = tscBegin();
+        sample = tscEnd() - start;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    return double(samples[samples.size() / 2]);
+}
+
+
+double
+tscPerNs(){
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t tsc = tscBegin();
+
+    while(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100));
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    return (tscEnd() - tsc) / elapsed.count();
+}
+
+
+/* 'per_call' divides a call into queries, for the batch kernels */
+template <typename Func>
+Result
+measure(const char* kernel, uint64_t n, Func func, double overhead, size_t per_call = 1){
+
+    const uint64_t warmup = 1000000;                // cycles: caches, predictors, clock
+    const uint64_t min_sample = 2000;               // cycles, against the timer's noise
+    const uint64_t budget = 200000000;              // cycles per (kernel, n)
+
+    uint64_t warm_start = tscBegin();
+
+    for(size_t k = 0; k < 100 || tscEnd() - warm_start < warmup; k++)
+        keep(func(opaque(n)));
+
+    // the number of calls that makes a sample long enough:
+    size_t calls = 1;
+
+    while(true){
+
+        uint64_t start = tscBegin();
+
+        for(size_t k = 0; k < calls; k++)
+            keep(func(opaque(n)));
+
+        if(tscEnd() - start >= min_sample || calls >= (1 << 20))
+            break;
+
+        calls *= 2;
+    }
+
+    std::vector<double> per_query;
+    uint64_t spent = 0;
+
+    while(per_query.size() < 11 || (spent < budget && per_query.size() < 10000)){
+
+        uint64_t start = tscBegin();
+
+        for(size_t k = 0; k < calls; k++)
+            keep(func(opaque(n)));
+
+        uint64_t cycles = tscEnd() - start;
+
+        spent += cycles;
+        per_query.push_back(std::max(0.0, cycles - overhead) / (calls * per_call));
+    }
+
+    std::sort(per_query.begin(), per_query.end());
+
+    size_t count = per_query.size();
+    size_t p99 = std::min(count - 1, count * 99 / 100);
+
+    return Result{kernel, n, calls, count, per_query[count / 2], per_query[p99], per_query[0]};
+}
+
+
+uint64_t
+iterative(uint64_t n){
+
+    uint64_t a = 0, b = 1;
+
+    for(uint64_t i = 0; i < n; i++){
+
+        uint64_t next = a + b;
+        a = b;
+        b = next;
+    }
+
+    return a;
+}
+
+
+/* Each kernel against the table (mod 2^64 past F(93)), and fib_mod against fib_big */
+bool
+verify(){
+
+    bool ok = true;
+
+    for(uint64_t n = 0; n < 94; n++){
+
+        uint64_t expected = fib_constexpr::fib_table[n];
+        uint64_t checked = 0;
+
+        if(fastFib(uint32_t(n)) != expected || iterative(n) != expected || fib_doubling(n) != expected ||
+           fib_u64(n) != expected || !fib_checked(n, &checked) || checked != expected){
+
+            std::fprintf(stderr, "wrong F(%llu)\n", (unsigned long long)n);
+            ok = false;
+        }
+    }
+
+    for(uint64_t n : {100, 1000, 12345}){
+
+        fib_limbs exact = fib_big(n);
+
+        for(uint64_t m : {1000000007ull, 1000000000000000000ull, 0xFFFFFFFFFFFFFFC5ull}){
+
+            uint64_t out = 0;
+            fib_mod_batch(&n, &m, &out, 1);
+
+            if(fib_mod(n, m) != fib_big_mod(exact, m) || out != fib_big_mod(exact, m)){
+
+                std::fprintf(stderr, "wrong F(%llu) mod %llu\n", (unsigned long long)n, (unsigned long long)m);
+                ok = false;
+            }
+        }
+
+        if(fib_doubling(n) != exact[0] || iterative(n) != exact[0]){
+
+            std::fprintf(stderr, "wrong F(%llu) mod 2^64\n", (unsigned long long)n);
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+
+int main(int argc, char* argv[]){
+
+    bool json = argc > 1 && std::strcmp(argv[1], "--json") == 0;
+
+    if(!verify())
+        return 1;
+
+    double overhead = timerOverhead();
+    double ghz = tscPerNs();
+    std::vector<Result> results;
+
+    const uint64_t small_n[] = {1, 10, 30, 60, 93};
+    const uint64_t mod_n[] = {93, 1000000, 1000000000000ull, 1000000000000000000ull};
+    const uint64_t big_n[] = {1000, 10000, 100000, 1000000};
+
+    const uint64_t odd_m = 1000000007, even_m = 1000000000000000000ull;
+
+    const size_t lanes = 256;
+    std::vector<uint64_t> lane_n(lanes), lane_m(lanes, odd_m), lane_out(lanes);
+
+    for(uint64_t n : small_n){
+
+        results.push_back(measure("fastFib", n, [](uint64_t x){ return fastFib(uint32_t(x)); }, overhead));
+        results.push_back(measure("iterative", n, iterative, overhead));
+        results.push_back(measure("fib_doubling", n, fib_doubling, overhead));
+        results.push_back(measure("fib_u64", n, fib_u64, overhead));
+        results.push_back(measure("constexpr", n, fib_constexpr::fib_u64, overhead));
+    }
+
+    for(uint64_t n : mod_n){
+
+        results.push_back(measure("fib_mod_odd", n, [&](uint64_t x){ return fib_mod(x, odd_m); }, overhead));
+        results.push_back(measure("fib_mod_even", n, [&](uint64_t x){ return fib_mod(x, even_m); }, overhead));
+
+        results.push_back(measure("fib_mod_batch_odd", n, [&](uint64_t x){
+
+            std::fill(lane_n.begin(), lane_n.end(), x);
+            fib_mod_batch(lane_n.data(), lane_m.data(), lane_out.data(), lanes);
+
+            return lane_out[0];
+        }, overhead, lanes));
+    }
+
+    for(uint64_t n : big_n)
+        results.push_back(measure("fib_big", n, [](uint64_t x){ return fib_big(x).size(); }, overhead));
+
+    if(json){
+
+        std::printf("{\n  \"tsc_ghz\": %.3f,\n  \"timer_overhead_cycles\": %.1f,\n  \"results\": [\n",
+                    ghz, overhead);
+
+        for(size_t i = 0; i < results.size(); i++){
+
+            const Result& r = results[i];
+
+            std::printf("    {\"kernel\": \"%s\", \"n\": %llu, \"calls_per_sample\": %zu, \"samples\": %zu, "
+                        "\"median_cycles\": %.2f, \"p99_cycles\": %.2f, \"min_cycles\": %.2f, \"median_ns\": %.2f}%s\n",
+                        r.kernel.c_str(), (unsigned long long)r.n, r.calls, r.samples,
+                        r.median, r.p99, r.min, r.median / ghz, i + 1 < results.size() ? "," : "");
+        }
+
+        std::printf("  ]\n}\n");
+    }
+    else{
+
+        std::printf("kernel,n,calls_per_sample,samples,median_cycles,p99_cycles,min_cycles,median_ns\n");
+
+        for(const Result& r : results){
+
+            std::printf("%s,%llu,%zu,%zu,%.2f,%.2f,%.2f,%.2f\n",
+                        r.kernel.c_str(), (unsigned long long)r.n, r.calls, r.samples,
+                        r.median, r.p99, r.min, r.median / ghz);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ *  Throughput of F(n) mod m (fib_mod & fib_mod_batch in Fast_Fibonacci.s).
+ *
+ *  The same random queries (n of 64 bits) go through fib_mod one by one,
+ *  then through fib_mod_batch, for four kinds of moduli:
+ *  odd below 2^62 (Montgomery, short folds), odd of 64 bits (Montgomery),
+ *  even (divq) and a mix of all three.
+ *
+ *  Each run times both, back to back, so a run's speedup compares the same machine state.
+ *  The line gives the medians over the runs, and the spread (min - max) of the speedup.
+ *
+ *  Build & run:
+ *      as --defsym FIB_LIBRARY=1 Fast_Fibonacci.s -o fib_kernels.o
+ *      g++ -std=c++17 -O2 fib_mod_bench.cpp fib_kernels.o -o fib_mod_bench
+ *      ./fib_mod_bench
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Fast_Fibonacci.h"
+
+
+double queriesPerSecond(bool batch, const std::vector<uint64_t>& n, const std::vector<uint64_t>& m,
+                        std::vector<uint64_t>& out){
+
+    auto start = std::chrono::steady_clock::now();
+
+    if(batch)
+        fib_mod_batch(n.data(), m.data(), out.data(), n.size());
+
+    else{
+        for(size_t i = 0; i < n.size(); i++)
+            out[i] = fib_mod(n[i], m[i]);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return n.size() / elapsed.count();
+}
+
+
+double median(std::vector<double> values){
+
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+
+int main(){
+
+    std::mt19937_64 gen(2024);
+    const size_t num_queries = 200000;
+    const int runs = 11;
+
+    const char* kinds[] = {"odd 62", "odd 64", "even", "mixed"};
+
+    std::printf("%8s %16s %16s %10s %16s\n", "moduli", "single q/s", "batch q/s", "speedup", "spread");
+
+    for(int kind = 0; kind < 4; kind++){
+
+        std::vector<uint64_t> n(num_queries), m(num_queries), out(num_queries);
+
+        for(size_t i = 0; i < num_queries; i++){
+
+            n[i] = gen();
+            m[i] = gen() | 2;
+
+            int mod_kind = kind < 3 ? kind : int(gen() % 3);
+
+            if(mod_kind == 0)
+                m[i] = (m[i] >> 2) | 1;
+            else if(mod_kind == 1)
+                m[i] |= 1;
+            else
+                m[i] &= ~uint64_t(1);
+        }
+
+        uint64_t checksum = 0;
+        std::vector<double> single(runs), batch(runs), speedup(runs);
+
+        for(int run = 0; run < runs; run++){
+
+            single[run] = queriesPerSecond(false, n, m, out);
+            for(uint64_t r : out)
+                checksum += r;
+
+            batch[run] = queriesPerSecond(true, n, m, out);
+            for(uint64_t r : out)
+                checksum -= r;
+
+            speedup[run] = batch[run] / single[run];
+        }
+
+        auto spread = std::minmax_element(speedup.begin(), speedup.end());
+
+        std::printf("%8s %16.0f %16.0f %9.2fx %7.2fx - %.2fx   (%llu)\n",
+                    kinds[kind], median(single), median(batch), median(speedup),
+                    *spread.first, *spread.second, (unsigned long long)checksum);
+    }
+
+    return 0;
+}
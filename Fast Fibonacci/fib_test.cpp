@@ -0,0 +1,185 @@
+/*
+ *  Behaviour tests of the F(n) kernels in this directory.
+ *
+ *  Known values (worked out independently with exact integers) for fib_mod, fib_big & the table,
+ *  and every kernel against another one: fib_doubling, fib_u64, fib_checked & fastFib against
+ *  the constexpr table, fib_mod_batch against fib_mod on random queries of every modulus kind,
+ *  fib_big_mod of fib_big against fib_mod.
+ *  A failure prints what was expected, the exit status is the number of failures (capped).
+ *
+ *  Build & run:
+ *      as --defsym FIB_LIBRARY=1 Fast_Fibonacci.s -o fib_kernels.o
+ *      g++ -std=c++17 -O2 fib_test.cpp fib_kernels.o -pthread -o fib_test
+ *      ./fib_test
+ */
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Fast_Fibonacci.h"
+#include "Fast_Fibonacci_Big.h"
+#include "Fast_Fibonacci_Table.h"
+
+
+static int failures = 0;
+
+static void check(bool ok, const char* what, uint64_t n, uint64_t got, uint64_t expected){
+
+    if(ok)
+        return;
+
+    failures++;
+    std::printf("FAIL %s(%llu): %llu, expected %llu\n", what, (unsigned long long)n,
+                (unsigned long long)got, (unsigned long long)expected);
+}
+
+
+/*   ***   64-bit kernels   ***   */
+
+static void testTable(){
+
+    for(uint64_t n = 0; n < 120; n++){
+
+        uint64_t expected = n < fib_constexpr::fib_count ? fib_constexpr::fib_u64(n) : UINT64_MAX;
+        check(fib_u64(n) == expected, "fib_u64", n, fib_u64(n), expected);
+
+        uint64_t out = 0;
+        int fits = fib_checked(n, &out);
+        check(fits == (n <= 93) && out == expected, "fib_checked", n, out, expected);
+
+        if(n <= 93){
+            check(fib_doubling(n) == expected, "fib_doubling", n, fib_doubling(n), expected);
+            check(fastFib(uint32_t(n)) == expected, "fastFib", n, fastFib(uint32_t(n)), expected);
+        }
+    }
+
+    check(fib_u64(93) == 12200160415121876738ull, "fib_u64", 93, fib_u64(93), 12200160415121876738ull);
+}
+
+
+static void testMod(){
+
+    struct known { uint64_t n, m, f; };
+
+    const known values[] = {
+        {100, 1000000007, 687995182},
+        {1000000000000000000ull, 1000000007, 209783453},
+        {UINT64_MAX, 1000000007, 683972503},
+        {UINT64_MAX, UINT64_MAX, 4093298358055684510ull},           // odd, 64 bits
+        {UINT64_MAX, (1ull << 61) - 1, 610},                        // odd, below 2^62
+        {12345678901234567ull, 1ull << 63, 4052540867049746701ull}, // even
+        {1000000000000000ull, 10000000000ull, 9560546875ull},
+        {1000, 2, 1},
+        {93, 0, 0},
+        {93, 1, 0},
+        {0, 1000000007, 0},
+        {1, 1000000007, 1},
+    };
+
+    for(const known& v : values)
+        check(fib_mod(v.n, v.m) == v.f, "fib_mod", v.n, fib_mod(v.n, v.m), v.f);
+
+    for(uint64_t n = 0; n <= 93; n++){
+
+        uint64_t m = 1000000007;
+        check(fib_mod(n, m) == fib_u64(n) % m, "fib_mod", n, fib_mod(n, m), fib_u64(n) % m);
+        check(fib_mod(n, UINT64_MAX) == fib_u64(n) % UINT64_MAX, "fib_mod", n,
+              fib_mod(n, UINT64_MAX), fib_u64(n) % UINT64_MAX);
+    }
+}
+
+
+/* Every count (the lanes and the tail), and out aliasing n */
+static void testBatch(){
+
+    std::mt19937_64 gen(2024);
+
+    for(size_t count = 0; count < 40; count++){
+
+        std::vector<uint64_t> n(count), m(count), out(count);
+
+        for(size_t i = 0; i < count; i++){
+
+            n[i] = gen() >> (gen() % 64);
+
+            switch(gen() % 4){
+                case 0:  m[i] = (gen() >> 2) | 1; break;        // odd, below 2^62
+                case 1:  m[i] = gen() | 1; break;               // odd, 64 bits
+                case 2:  m[i] = gen() & ~uint64_t(1); break;    // even
+                default: m[i] = gen() % 3; break;               // 0, 1 & 2
+            }
+        }
+
+        fib_mod_batch(n.data(), m.data(), out.data(), count);
+
+        for(size_t i = 0; i < count; i++)
+            check(out[i] == fib_mod(n[i], m[i]), "fib_mod_batch", n[i], out[i], fib_mod(n[i], m[i]));
+
+        std::vector<uint64_t> in_place = n;
+        fib_mod_batch(in_place.data(), m.data(), in_place.data(), count);
+
+        for(size_t i = 0; i < count; i++)
+            check(in_place[i] == out[i], "fib_mod_batch in place", n[i], in_place[i], out[i]);
+    }
+}
+
+
+/*   ***   fib_big   ***   */
+
+static void checkDecimal(uint64_t n, const std::string& got, const std::string& expected){
+
+    if(got == expected)
+        return;
+
+    failures++;
+    std::printf("FAIL fib_big(%llu): %s, expected %s\n", (unsigned long long)n, got.c_str(), expected.c_str());
+}
+
+static void testBig(){
+
+    checkDecimal(0, fib_big_decimal(fib_big(0)), "0");
+    checkDecimal(100, fib_big_decimal(fib_big(100)), "354224848179261915075");
+    checkDecimal(1000, fib_big_decimal(fib_big(1000)),
+                 "43466557686937456435688527675040625802564660517371780402481729089536555417949051890403879840079"
+                 "255169295922593080322634775209689623239873322471161642996440906533187938298969649928516003704476"
+                 "137795166849228875");
+
+    for(uint64_t n = 0; n <= 93; n++){
+
+        std::string expected = std::to_string(fib_u64(n));
+        checkDecimal(n, fib_big_decimal(fib_big(n)), expected);
+    }
+
+    // 20899 digits: past the schoolbook products
+    std::string digits = fib_big_decimal(fib_big(100000));
+    check(digits.size() == 20899, "fib_big digits", 100000, digits.size(), 20899);
+    checkDecimal(100000, digits.substr(0, 20), "25974069347221724166");
+    checkDecimal(100000, digits.substr(digits.size() - 20), "49895374653428746875");
+
+    // The NTT products, against fib_mod
+    const uint64_t moduli[] = {1000000007, UINT64_MAX, 1ull << 63};
+
+    for(uint64_t n : {100000ull, 1000000ull, 3000017ull}){
+
+        fib_limbs f = fib_big(n);
+
+        for(uint64_t m : moduli)
+            check(fib_big_mod(f, m) == fib_mod(n, m), "fib_big_mod", n, fib_big_mod(f, m), fib_mod(n, m));
+    }
+}
+
+
+int main(){
+
+    testTable();
+    testMod();
+    testBatch();
+    testBig();
+
+    if(failures == 0)
+        std::printf("all passed\n");
+
+    return failures < 100 ? failures : 100;
+}
@@ -6,30 +6,60 @@
 #include <cmath>
 #include <cstdbool>
 #include <cstdlib>
+#include <future>
 #include <iterator>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "avl_balance.h"
 #include "avl_iterator.h"
+#include "avl_stats.h"
 #include "avl_utils.h"
 
 
+/* Needs C++17 (if constexpr on the Balance policy) */
+
 /* Type 'T' MUST SUPPORT Default C'tor */
 
-template <typename T, typename Comp = std::less<T>>
-class avl {
+/* 'Comp' is a less-than comparator, or an opt-in three-way one (see avl_comp_traits) */
+
+/* 'Stats' is a policy from avl_stats.h. The default avl_no_stats costs nothing */
+
+/* 'Balance' is a policy from avl_balance.h: avl_balance (default), wavl_balance or rb_balance */
+
+template <typename T, typename Comp = std::less<T>, typename Stats = avl_no_stats, 
+          typename Balance = avl_balance>
+class avl : private avl_ebo<Stats, 0>, private avl_ebo<Comp, 1> {
     struct node<T>* root;
     struct node<T>* min;
     struct node<T>* max;
     size_t tree_size;
 
+    /* The block of compact(). Nodes allocated later are still on the heap */
+    struct compact_arena {
+        node<T>* block;
+        size_t size;
+        size_t live;        // the nodes of the block that are still in the tree
+    };
+
+    /* Null until compact() runs, and again once the block empties */
+    compact_arena* arena;
+
+    static constexpr bool three_way_comp = avl_comp_traits<T, Comp>::three_way;
+
 public:
-    const Comp& key_comp;
+    Comp key_comp() const;
 
 // Constractors:
     avl();
     explicit avl(const Comp& comp);
     avl(const avl& src);
-    // TODO: Add Move C'tor
+
+    /* Takes the nodes of 'src' (and its compact() block), 'src' is left empty. O(1) */
+    avl(avl&& src) noexcept(std::is_nothrow_copy_constructible<Comp>::value);
 
     /* Build a Tree in O(size) if sorted gets true */
     explicit avl(std::vector<T> elements, bool sorted = false);
@@ -37,7 +67,9 @@ public:
     avl(T* elements, size_t arr_size, bool sorted = false);
     avl(T* elements, size_t arr_size, const Comp& comp, bool sorted = false);
 
-    avl<T, Comp>& operator=(const avl<T, Comp>& src);
+    avl<T, Comp, Stats, Balance>& operator=(const avl<T, Comp, Stats, Balance>& src);
+    avl<T, Comp, Stats, Balance>& operator=(avl<T, Comp, Stats, Balance>&& src)
+            noexcept(std::is_nothrow_copy_assignable<Comp>::value);
     ~avl();
 
 // Operations:
@@ -47,19 +79,44 @@ public:
     
     size_t rank(const T& key) const;
     const T& select(size_t index) const;
+
+/* Batch order statistics. All the batch is answered in one shared traversal */
+    std::vector<T> select_many(const std::vector<size_t>& sorted_indices) const;
+    std::vector<T> quantiles(size_t k) const;
+    std::vector<size_t> rank_many(const std::vector<T>& sorted_keys) const;
     
     T& getRef(const T& key);
     T getCopy(const T& key); // TODO
     const T& getMin() const;
     const T& getMax() const;
-    T popMin(); // TODO
-    T popMax(); // TODO
+    T popMin();
+    T popMax();
     size_t size() const;
     bool empty() const;
     std::vector<T> getAll() const;
 
+// Bounded insert (avl_topk.h keeps the bound, so a plain tree stores nothing for it):
+/* Inserts 'element' and evicts one key if the tree gets over 'capacity'.
+ * EVICT_MIN keeps the largest keys, EVICT_MAX the smallest.
+ * Returns false if 'element' exists or would be the one evicted, 
+ * which is known in O(1) from the min/max */
+    bool offer(T element, size_t capacity, AVL_EVICT evict = EVICT_MIN);
+
+/* Evicts keys from one side until at most 'capacity' are left. Returns the number evicted */
+    size_t shrink_to(size_t capacity, AVL_EVICT evict = EVICT_MIN);
+
+// Memory layout:
+/* Moves every node into one contiguous block, in van Emde Boas (default) or BFS order.
+ * The shape and the keys stay. O(n). Invalidates iterators, like insert & remove do */
+    void compact(AVL_LAYOUT layout = VAN_EMDE_BOAS);
+
+// Instrumentation:
+    avl_stats_snapshot stats() const;
+    void resetStats();
+
 // const-iterator:
     class iterator : public avl_iterator<T>{
+        friend class avl;
     public:
         iterator();
         iterator(node<T>* root);
@@ -67,6 +124,36 @@ public:
 
     iterator begin() noexcept;
     iterator end();
+
+/* Hinted insert. hint == end() expects a new max, hint == begin() a new min.
+ * Then no comparison is made on the way down the spine */
+    iterator insert(iterator hint, T element);
+
+/* Bulk removal. Each returns the number of keys removed.
+ * O(log(n)) split & join with avl_balance. The other policies go through erase_if */
+    size_t erase(iterator first, iterator last);
+    size_t erase_range(const T from, const T to);       // [from, to)
+    template <typename Pred>
+    size_t erase_if(Pred pred);
+
+// Set algebra. The result replaces this tree:
+/* Split & join divide-and-conquer, O(m*log(n/m + 1)) for sizes m <= n, with avl_balance.
+ * Big subproblems run in parallel when Stats is avl_no_stats (the counting hooks aren't thread-safe).
+ * An rvalue 'other' gives its nodes to the result and is left empty. A const one is copied first.
+ * The other policies merge the sorted keys and rebuild in O(n + m) */
+    void set_union(const avl& other);
+    void set_union(avl&& other);
+    void set_intersection(const avl& other);
+    void set_intersection(avl&& other);
+    void set_difference(const avl& other);          // this \ other
+    void set_difference(avl&& other);
+    void symmetric_difference(const avl& other);
+    void symmetric_difference(avl&& other);
+
+// Non-throwing lookup & update (for hot paths):
+    std::pair<iterator, bool> try_insert(T element);
+    bool try_remove(const T& element);
+    iterator find(const T& key) const;
     
 // Tree Traversals:
     template <typename Functor>
@@ -81,27 +168,86 @@ public:
 // Const Tree Traversals (for read-only use):
     template <typename Functor>
     void constInorder(Functor& func) const;
+
+/* Early-exit scans, in order, from the first key >= 'start' (or from the min).
+ * The visitor gets a const T& and returns VISIT_CONTINUE or VISIT_STOP.
+ * No recursion & no heap memory. O(log(n) + visited). Returns the number of visited keys */
+    template <typename Visitor>
+    size_t scan(const T& start, Visitor visitor) const;
+
+    template <typename Visitor>
+    size_t scan(Visitor visitor) const;
     
 private:
+    /* The height is below 1.45*log(n) with AVL and 2*log(n) with WAVL & red-black,
+     * so a stack of 128 nodes covers any tree that fits in memory */
+    static constexpr int scan_stack_size = 128;
+
+    /* The root-to-key path of try_insert, kept up to date by insertAux through a rolling */
+    struct insert_path {
+        node<T>* nodes[scan_stack_size];
+        int length = 0;
+    };
+
     using vec_iter = typename std::vector<T>::iterator;
 
-    /* Equality check of two keys. For internal use */
-    bool keysEqual(const T& k1, const T& k2) const;
+    /* key comparisons, counted by the Stats policy. For internal use */
+    bool less(const T& k1, const T& k2) const;
+    int compare(const T& k1, const T& k2) const;
+    const Comp& keyComp() const;
+
+// Node allocation (counted by the Stats policy):
+    const Stats& statsPolicy() const;
+    node<T>* newNode();
+    node<T>* newNode(const T& key);
+    void deleteTree(node<T>* iter);
+    void freeNodes(node<T>* iter);
+    bool inArena(const node<T>* iter) const;
     
 // Auxiliary Functions:
-    node<T>* find(const T& key) const;
-    AVL_STATUS insertAux(node<T>* iter, T& element);
+    node<T>* findNode(const T& key) const;
+    void removeNode(node<T>* to_remove, const T element);
+    AVL_STATUS insertAux(node<T>* iter, T& element, node<T>* candidate = nullptr, 
+                         bool right_spine = true, insert_path* path = nullptr);
+    AVL_STATUS insertFixPath(node<T>* iter, const T& element, insert_path* path);
+    iterator pathIterator(const insert_path& path) const;
+    AVL_STATUS insertSpineAux(node<T>* iter, T& element, bool right_spine);
     AVL_STATUS removeLeaf(node<T>* iter, T leaf);
+    T popSpine(bool right_spine);
+    AVL_STATUS popSpineAux(node<T>* iter, T& popped, bool right_spine);
     const T& selectAux(node<T>* iter, size_t index) const;
+    void selectManyAux(node<T>* iter, const size_t* first, const size_t* last,
+                       size_t offset, T* out, const size_t* indices) const;
+    void rankManyAux(node<T>* iter, const T* first, const T* last,
+                     size_t offset, size_t* out, const T* keys) const;
     void updateMinAndMax();
+    void updateMinAndMax(AVL_STATUS insert_status);
+    void updateMin();
+    void updateMax();
+
+// Split & join (for bulk operations, with a joinable Balance only):
+    node<T>* join(node<T>* left, node<T>* mid, node<T>* right);
+    node<T>* join2(node<T>* left, node<T>* right);
+    void split(node<T>* iter, const T& key, node<T>*& left, node<T>*& found, node<T>*& right);
+    node<T>* extractMin(node<T>*& iter);
+    void resetRoot(node<T>* new_root);
 
-// Height balance:
-    AVL_STATUS updateHeight(node<T>* iter);
-    int balanceFactor(node<T>* iter);
-    void genericRollingPart(node<T>* B);
-    void swapSons(node<T>* father);
+// Set algebra Auxiliary:
+    /* Subproblems with fewer nodes run on the calling thread */
+    static constexpr size_t parallel_grain = 1 << 15;
+
+    void setAlgebra(avl& other, AVL_SET_OP op);
+    node<T>* setAlgebraAux(node<T>* iter1, node<T>* iter2, AVL_SET_OP op,
+                           std::vector<node<T>*>& dropped, int forks);
+    void mergeAlgebra(const avl& other, AVL_SET_OP op);
+
+// compact Auxiliary Functions:
+    void vebOrder(node<T>* iter, int levels, std::vector<node<T>*>& order);
+    void collectAtDepth(node<T>* iter, int depth, std::vector<node<T>*>& out);
+    int countLevels(node<T>* iter) const;
 
 // Build almost-complete tree:
+    void rebuild(std::vector<T>& sorted_elem);
     void buildAlmostCompleteTree(size_t size);
     node<T>* buildCompleteTree(int height);
     void removeLeaves(node<T>** it_ptr, int& num_to_remove, int root_height);
@@ -118,6 +264,10 @@ private:
 // Const Tree Traversals (for read-only use):
     template <typename Functor>
     void constInorderAux(Functor& func, node<T>* iter) const;
+
+// scan Auxiliary:
+    template <typename Visitor>
+    size_t scanAux(node<T>** stack, int top, Visitor& visitor) const;
 };
 
 #endif  /* AVL_H_ */
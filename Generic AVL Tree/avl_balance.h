@@ -0,0 +1,460 @@
+#ifndef AVL_BALANCE_H_
+#define AVL_BALANCE_H_
+
+#include <cstdlib>
+#include <utility>
+
+#include "avl_node.h"
+#include "avl_utils.h"
+
+
+/*
+ *  Balancing policies.
+ *
+ *  avl<T, Comp, Stats, Balance> owns the descent, the weights and the key moves.
+ *  The policy owns the 'height' field of the nodes and the rotations:
+ *
+ *  insertFix(iter, stats)  - a son of 'iter' was added or has grown.
+ *                            Returns WAS_HEIGHT_UPDATE to go on to the father,
+ *                            SUCCESS or WAS_ROLLING to stop.
+ *  removeFix(iter, stats)  - a son of 'iter' was removed or has shrunk.
+ *                            Returns SUCCESS to stop, otherwise goes on to the father.
+ *  initRank(iter)          - sets 'height' of a node of a built tree (sons first).
+ *  joinable                - 'height' is the real height, so split & join work.
+ *
+ *  The weights of 'iter' and its sons are up to date when a fix is called,
+ *  and the rotations keep them so. That's how rank & select work with every policy.
+ */
+
+
+/*   ***   Rank based rotations   ***   */
+
+/* The rank of a null son is -1 */
+template <class T>
+int rankOf(node<T>* iter){
+    return iter ? iter->height : -1;
+}
+
+/*
+ *  'iter' stays the root of the subtree, the keys move (as in the AVL rolling).
+ *  Each rank moves with its key, so the caller promotes & demotes keys, not nodes.
+ */
+template <class T>
+void rotateRight(node<T>* iter){
+
+    node<T>* son = iter->left;
+
+    std::swap(iter->key, son->key);
+    std::swap(iter->height, son->height);
+
+    iter->left = son->left;
+    son->left = son->right;
+    son->right = iter->right;
+    iter->right = son;
+
+    son->updateWeight();
+    iter->updateWeight();
+}
+
+template <class T>
+void rotateLeft(node<T>* iter){
+
+    node<T>* son = iter->right;
+
+    std::swap(iter->key, son->key);
+    std::swap(iter->height, son->height);
+
+    iter->right = son->right;
+    son->right = son->left;
+    son->left = iter->left;
+    iter->left = son;
+
+    son->updateWeight();
+    iter->updateWeight();
+}
+
+
+/*   ***   AVL   ***   */
+
+/* The default. Heights of the sons differ by at most 1. Deletion may roll O(log(n)) times */
+struct avl_balance {
+    static constexpr bool joinable = true;
+
+    template <class T, class Stats>
+    static AVL_STATUS insertFix(node<T>* iter, const Stats& stats){
+        return updateHeight(iter, stats);
+    }
+
+    template <class T, class Stats>
+    static AVL_STATUS removeFix(node<T>* iter, const Stats& stats){
+        return updateHeight(iter, stats);
+    }
+
+    template <class T>
+    static void initRank(node<T>* iter){
+        iter->height = 1 + maxHeight<T>(iter->left, iter->right);
+    }
+
+private:
+    template <class T, class Stats>
+    static AVL_STATUS updateHeight(node<T>* iter, const Stats& stats){
+
+        int old_height = iter->height;
+        int balance_f = balanceFactor(iter);
+
+        if(balance_f == 2){
+            int son_f = balanceFactor(iter->left);
+            stats.onRotation(son_f == -1);
+
+            switch(son_f){
+
+            case -1:    // LR-rolling. which is RR(left son) + LL
+                genericRollingPart(iter->left);
+                swapSons(iter->left->right);
+                swapSons(iter->left);
+
+            default:    // LL-rolling
+                swapSons(iter);
+                swapSons(iter->right);
+                genericRollingPart(iter);
+            }
+        }
+
+        if(balance_f == -2){
+            int son_f = balanceFactor(iter->right);
+            stats.onRotation(son_f == 1);
+
+            switch(son_f){
+
+            case 1:     // RL-rolling. which is LL(right son) + RR
+                swapSons(iter->right);
+                swapSons(iter->right->right);
+                genericRollingPart(iter->right);
+
+            default:    // RR-rolling
+                genericRollingPart(iter);
+                swapSons(iter->right);
+                swapSons(iter);
+            }
+        }
+
+        iter->height = 1 + maxHeight<T>(iter->left, iter->right);
+
+        if(std::abs(balance_f) > 1)
+            return WAS_ROLLING;
+
+        if(iter->height != old_height)
+            return WAS_HEIGHT_UPDATE;
+
+        return SUCCESS;
+    }
+
+    template <class T>
+    static int balanceFactor(node<T>* iter){
+
+        int left_height = 0, right_height = 0;
+
+        if(iter->left)
+            left_height = iter->left->height + 1;
+
+        if(iter->right)
+            right_height = iter->right->height + 1;
+
+        return left_height - right_height;
+    }
+
+    template <class T>
+    static void genericRollingPart(node<T>* B){
+
+        std::swap(B->key, B->right->key);
+        std::swap(B->left, B->right->right);
+
+        B->right->height = 1 + maxHeight<T>(B->right->left, B->right->right);
+        B->height = 1 + maxHeight<T>(B->left, B->right);
+
+        B->right->updateWeight();
+        B->updateWeight();
+    }
+
+    template <class T>
+    static void swapSons(node<T>* father){
+        std::swap(father->left, father->right);
+    }
+};
+
+
+/*   ***   Weak AVL   ***   */
+
+/*
+ *  'height' is a rank. Every rank difference is 1 or 2 and a leaf has rank 0.
+ *  Insertion rolls like AVL (a WAVL built by insertions only is an AVL tree).
+ *  Deletion rolls at most twice and then stops, and demotions are O(1) amortized.
+ *  The height is at most 2*log(n).
+ */
+struct wavl_balance {
+    static constexpr bool joinable = false;
+
+    template <class T, class Stats>
+    static AVL_STATUS insertFix(node<T>* iter, const Stats& stats){
+
+        int rank = iter->height;
+        bool left_zero = rankOf(iter->left) == rank;
+
+        // no 0-son, nothing to fix:
+        if(!left_zero && rankOf(iter->right) != rank)
+            return SUCCESS;
+
+        node<T>* son = left_zero ? iter->left : iter->right;
+        node<T>* brother = left_zero ? iter->right : iter->left;
+
+        if(rank - rankOf(brother) == 1){
+
+            iter->height++;
+            return WAS_HEIGHT_UPDATE;
+        }
+
+        node<T>* inner = left_zero ? son->right : son->left;
+
+        if(rankOf(son) - rankOf(inner) == 2){
+            stats.onRotation(false);
+
+            if(left_zero){
+                rotateRight(iter);
+                iter->right->height--;
+            }
+            else{
+                rotateLeft(iter);
+                iter->left->height--;
+            }
+
+            return WAS_ROLLING;
+        }
+
+        stats.onRotation(true);
+
+        if(left_zero){
+            rotateLeft(iter->left);
+            rotateRight(iter);
+        }
+        else{
+            rotateRight(iter->right);
+            rotateLeft(iter);
+        }
+
+        iter->height++;
+        iter->left->height--;
+        iter->right->height--;
+
+        return WAS_ROLLING;
+    }
+
+    template <class T, class Stats>
+    static AVL_STATUS removeFix(node<T>* iter, const Stats& stats){
+
+        int rank = iter->height;
+
+        // a 2,2-leaf is demoted:
+        if(iter->left == nullptr && iter->right == nullptr){
+
+            if(rank == 0)
+                return SUCCESS;
+
+            iter->height = 0;
+            return WAS_HEIGHT_UPDATE;
+        }
+
+        bool left_three = rank - rankOf(iter->left) == 3;
+
+        if(!left_three && rank - rankOf(iter->right) != 3)
+            return SUCCESS;
+
+        node<T>* brother = left_three ? iter->right : iter->left;
+        int brother_rank = brother->height;
+
+        if(rank - brother_rank == 2){
+
+            iter->height--;
+            return WAS_HEIGHT_UPDATE;
+        }
+
+        node<T>* outer = left_three ? brother->right : brother->left;
+        node<T>* inner = left_three ? brother->left : brother->right;
+
+        if(brother_rank - rankOf(outer) == 2 && brother_rank - rankOf(inner) == 2){
+
+            iter->height--;
+            brother->height--;
+            return WAS_HEIGHT_UPDATE;
+        }
+
+        if(brother_rank - rankOf(outer) == 1){
+            stats.onRotation(false);
+
+            left_three ? rotateLeft(iter) : rotateRight(iter);
+
+            node<T>* demoted = left_three ? iter->left : iter->right;
+
+            iter->height++;
+            demoted->height--;
+
+            if(demoted->left == nullptr && demoted->right == nullptr)
+                demoted->height = 0;
+
+            return SUCCESS;
+        }
+
+        stats.onRotation(true);
+
+        if(left_three){
+            rotateRight(iter->right);
+            rotateLeft(iter);
+
+            iter->left->height -= 2;
+            iter->right->height--;
+        }
+        else{
+            rotateLeft(iter->left);
+            rotateRight(iter);
+
+            iter->right->height -= 2;
+            iter->left->height--;
+        }
+
+        iter->height += 2;
+
+        return SUCCESS;
+    }
+
+    template <class T>
+    static void initRank(node<T>* iter){
+        iter->height = 1 + maxHeight<T>(iter->left, iter->right);
+    }
+};
+
+
+/*   ***   Red-black   ***   */
+
+/*
+ *  Red-black in rank form: 'height' is the black height,
+ *  a son of rank difference 0 is red and 1 is black.
+ *  A red son has no red son.
+ *  Insertion rolls at most twice, deletion at most three times.
+ */
+struct rb_balance {
+    static constexpr bool joinable = false;
+
+    template <class T, class Stats>
+    static AVL_STATUS insertFix(node<T>* iter, const Stats& stats){
+
+        int rank = iter->height;
+
+        for(int side = 0; side < 2; side++){
+
+            bool left = (side == 0);
+            node<T>* son = left ? iter->left : iter->right;
+
+            if(rankOf(son) != rank)
+                continue;
+
+            bool outer_red = rankOf(left ? son->left : son->right) == rank;
+            bool inner_red = rankOf(left ? son->right : son->left) == rank;
+
+            if(!outer_red && !inner_red)
+                continue;
+
+            // red uncle: recolor
+            if(rankOf(left ? iter->right : iter->left) == rank){
+
+                iter->height++;
+                return WAS_HEIGHT_UPDATE;
+            }
+
+            // black uncle: the ranks stay, only the keys move
+            stats.onRotation(!outer_red);
+
+            if(!outer_red)
+                left ? rotateLeft(iter->left) : rotateRight(iter->right);
+
+            left ? rotateRight(iter) : rotateLeft(iter);
+
+            return WAS_ROLLING;
+        }
+
+        // a red son may be the red father of the violation one level up:
+        if(rankOf(iter->left) == rank || rankOf(iter->right) == rank)
+            return WAS_HEIGHT_UPDATE;
+
+        return SUCCESS;
+    }
+
+    template <class T, class Stats>
+    static AVL_STATUS removeFix(node<T>* iter, const Stats& stats){
+
+        int rank = iter->height;
+        bool left_two = rank - rankOf(iter->left) == 2;
+
+        if(!left_two && rank - rankOf(iter->right) != 2)
+            return SUCCESS;
+
+        node<T>* brother = left_two ? iter->right : iter->left;
+
+        // red brother: roll it up, then 'iter' is red and the fix below it stops
+        if(brother->height == rank){
+            stats.onRotation(false);
+
+            left_two ? rotateLeft(iter) : rotateRight(iter);
+            removeFix(left_two ? iter->left : iter->right, stats);
+
+            return SUCCESS;
+        }
+
+        int brother_rank = brother->height;
+        node<T>* outer = left_two ? brother->right : brother->left;
+        node<T>* inner = left_two ? brother->left : brother->right;
+
+        if(rankOf(outer) == brother_rank){
+            stats.onRotation(false);
+
+            left_two ? rotateLeft(iter) : rotateRight(iter);
+
+            iter->height++;
+            (left_two ? iter->left : iter->right)->height--;
+
+            return SUCCESS;
+        }
+
+        if(rankOf(inner) == brother_rank){
+            stats.onRotation(true);
+
+            if(left_two){
+                rotateRight(iter->right);
+                rotateLeft(iter);
+            }
+            else{
+                rotateLeft(iter->left);
+                rotateRight(iter);
+            }
+
+            iter->height++;
+            (left_two ? iter->left : iter->right)->height--;
+
+            return SUCCESS;
+        }
+
+        // black brother with black sons: recolor
+        iter->height--;
+        return WAS_HEIGHT_UPDATE;
+    }
+
+    /* In an almost-complete tree the nodes at the bottom level are red */
+    template <class T>
+    static void initRank(node<T>* iter){
+
+        int left_rank = rankOf(iter->left), right_rank = rankOf(iter->right);
+
+        iter->height = 1 + (left_rank < right_rank ? left_rank : right_rank);
+    }
+};
+
+
+#endif /* AVL_BALANCE_H_ */
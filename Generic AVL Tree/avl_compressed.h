@@ -0,0 +1,961 @@
+#ifndef AVL_COMPRESSED_H_
+#define AVL_COMPRESSED_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "avl_excep.h"
+#include "avl_utils.h"
+
+
+/*
+ *  Ordered set of integers in compressed blocks.
+ *
+ *  The keys are cut into blocks of up to 'B' consecutive keys. A block stores its least key
+ *  ('base') and each key as its offset from the base (frame of reference), in the narrowest of
+ *  1, 2, 4 or 8 bytes that fits the block's range. Densely clustered keys cost 1 or 2 bytes each,
+ *  instead of a node<T> per key.
+ *
+ *  The blocks are the nodes of an AVL tree ordered by base, and each node counts the keys
+ *  of its subtree, so rank & select are O(log(n/B) + B) and stay 1-based like avl's.
+ *  Inside a block, a search is a branch-free count over the offsets and a decode is a widening add,
+ *  both plain loops that the compiler vectorizes (as in avl_small).
+ *
+ *  A full block is split in two halves. A block under B/4 keys is merged into a neighbour.
+ *  The keys are ordered by '<'. select(), getMin(), getMax() & the iterator return keys by value,
+ *  since a key exists only in its encoded form. Iterators are invalidated by insert & remove.
+ */
+
+template <typename T, size_t B = 128>
+class avl_compressed {
+    static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value,
+                  "avl_compressed keeps integer keys");
+    static_assert(B >= 4, "a block holds at least 4 keys");
+
+    using U = typename std::make_unsigned<T>::type;
+
+    using offset_array = std::variant<std::vector<uint8_t>, std::vector<uint16_t>,
+                                      std::vector<uint32_t>, std::vector<uint64_t>>;
+
+    struct block_node {
+        T base;                     // the least key of the block
+        size_t count;
+        size_t total;               // keys in the subtree
+        int height;
+        block_node* left;
+        block_node* right;
+        offset_array offsets;       // key - base
+
+        block_node() : base(0), count(0), total(0), height(0), left(nullptr), right(nullptr){}
+        ~block_node(){ delete left; delete right; }
+    };
+
+    block_node* root;
+    size_t tree_size;
+
+public:
+// Constractors:
+    avl_compressed();
+    explicit avl_compressed(std::vector<T> elements, bool sorted = false);
+    avl_compressed(const avl_compressed& src);
+    avl_compressed& operator=(const avl_compressed& src);
+    ~avl_compressed();
+
+// Operations:
+    void insert(const T& element);
+    void remove(const T& element);
+    bool try_insert(const T& element);
+    bool try_remove(const T& element);
+    bool contains(const T& element) const;
+
+    size_t rank(const T& key) const;
+    T select(size_t index) const;
+
+    T getMin() const;
+    T getMax() const;
+    size_t size() const;
+    bool empty() const;
+    std::vector<T> getAll() const;
+
+    size_t block_count() const;
+
+    /* The blocks, their offsets & this object */
+    size_t memory_bytes() const;
+
+// const-iterator:
+    class iterator {
+        const avl_compressed* owner;
+        const block_node* block;        // null at the end
+        size_t pos;
+
+        friend class avl_compressed;
+        iterator(const avl_compressed* owner, const block_node* block)
+                : owner(owner), block(block), pos(0){}
+
+    public:
+        iterator() : owner(nullptr), block(nullptr), pos(0){}
+
+        T operator*() const{ return owner->keyAt(block, pos); }
+
+        iterator& operator++(){
+
+            if(++pos == block->count){
+
+                block = owner->nextBlock(block->base);
+                pos = 0;
+            }
+
+            return *this;
+        }
+
+        iterator operator++(int){ iterator ret_val = *this; ++(*this); return ret_val; }
+        bool operator==(const iterator& iter) const{ return block == iter.block && pos == iter.pos; }
+        bool operator!=(const iterator& iter) const{ return !(*this == iter); }
+    };
+
+    iterator begin() const;
+    iterator end() const;
+
+private:
+// Blocks:
+    block_node* newBlock(const T* keys, size_t count) const;
+    void encode(block_node* block, const T* keys, size_t count) const;
+    void decode(const block_node* block, T* out) const;
+    T keyAt(const block_node* block, size_t pos) const;
+
+    /* Number of keys of 'block' less than 'key' */
+    size_t lowerBound(const block_node* block, const T& key) const;
+    bool foundAt(const block_node* block, size_t pos, const T& key) const;
+
+    void mergeBlocks(block_node* lower, block_node* upper);
+
+// Index lookup:
+    /* The block of the greatest base <= key, or the first block */
+    block_node* findBlock(const T& key) const;
+    block_node* nextBlock(const T& base) const;
+    block_node* prevBlock(const T& base) const;
+
+// Index update (AVL by base):
+    static int heightOf(const block_node* iter);
+    static size_t totalOf(const block_node* iter);
+    static void update(block_node* iter);
+    static block_node* rotateLeft(block_node* iter);
+    static block_node* rotateRight(block_node* iter);
+    static block_node* rebalance(block_node* iter);
+
+    block_node* insertNode(block_node* iter, block_node* fresh);
+    block_node* removeNode(block_node* iter, T base);
+    block_node* detachMin(block_node* iter, block_node*& min_node);
+
+    /* Recounts the path to the block of 'base', after its keys changed */
+    void refresh(block_node* iter, const T& base);
+
+    block_node* buildIndex(std::vector<block_node*>& blocks, size_t first, size_t last);
+    block_node* clone(const block_node* iter) const;
+
+    void collect(const block_node* iter, std::vector<T>& out) const;
+    size_t bytesOf(const block_node* iter) const;
+};
+
+
+/*   ***   Constructors   ***   */
+
+template <typename T, size_t B>
+avl_compressed<T, B>::avl_compressed()
+        : root(nullptr), tree_size(0){
+}
+
+
+/* O(n) if sorted gets true. A duplicate throws non_unique_key, like the C'tors of avl */
+template <typename T, size_t B>
+avl_compressed<T, B>::avl_compressed(std::vector<T> elements, bool sorted)
+        : avl_compressed(){
+
+    if(!sorted)
+        std::sort(elements.begin(), elements.end());
+
+    for(size_t i = 1; i < elements.size(); i++){
+
+        if(!(elements[i - 1] < elements[i]))
+            throw non_unique_key<T>(elements[i]);
+    }
+
+    std::vector<block_node*> blocks;
+
+    for(size_t first = 0; first < elements.size(); first += B){
+
+        size_t count = std::min(B, elements.size() - first);
+        blocks.push_back(newBlock(elements.data() + first, count));
+    }
+
+    root = buildIndex(blocks, 0, blocks.size());
+    tree_size = elements.size();
+}
+
+
+template <typename T, size_t B>
+avl_compressed<T, B>::avl_compressed(const avl_compressed& src)
+        : root(clone(src.root)), tree_size(src.tree_size){
+}
+
+
+template <typename T, size_t B>
+avl_compressed<T, B>&
+avl_compressed<T, B>::operator=(const avl_compressed& src){
+
+    if(this == &src)
+        return *this;
+
+    block_node* new_root = clone(src.root);
+
+    delete root;
+    root = new_root;
+    tree_size = src.tree_size;
+
+    return *this;
+}
+
+
+template <typename T, size_t B>
+avl_compressed<T, B>::~avl_compressed(){
+    delete root;
+}
+
+
+/*   ***   Operations   ***   */
+
+template <typename T, size_t B>
+void
+avl_compressed<T, B>::insert(const T& element){
+
+    if(!try_insert(element))
+        throw key_already_exists<T>(element);
+}
+
+
+template <typename T, size_t B>
+void
+avl_compressed<T, B>::remove(const T& element){
+
+    if(!try_remove(element))
+        throw key_not_exist<T>(element);
+}
+
+
+template <typename T, size_t B>
+bool
+avl_compressed<T, B>::try_insert(const T& element){
+
+    if(root == nullptr){
+
+        root = newBlock(&element, 1);
+        tree_size = 1;
+        return true;
+    }
+
+    block_node* block = findBlock(element);
+    size_t pos = lowerBound(block, element);
+
+    if(foundAt(block, pos, element))
+        return false;
+
+    T keys[B + 1];
+    decode(block, keys);
+
+    std::copy_backward(keys + pos, keys + block->count, keys + block->count + 1);
+    keys[pos] = element;
+
+    size_t count = block->count + 1;
+    tree_size++;
+
+    if(count <= B){
+
+        encode(block, keys, count);
+        refresh(root, block->base);
+        return true;
+    }
+
+    // A full block is split. The lower half keeps the node:
+    size_t half = count / 2;
+
+    encode(block, keys, half);
+    refresh(root, block->base);
+
+    root = insertNode(root, newBlock(keys + half, count - half));
+
+    return true;
+}
+
+
+template <typename T, size_t B>
+bool
+avl_compressed<T, B>::try_remove(const T& element){
+
+    if(root == nullptr)
+        return false;
+
+    block_node* block = findBlock(element);
+    size_t pos = lowerBound(block, element);
+
+    if(!foundAt(block, pos, element))
+        return false;
+
+    tree_size--;
+
+    if(block->count == 1){
+
+        root = removeNode(root, block->base);
+        return true;
+    }
+
+    T keys[B + 1];
+    decode(block, keys);
+
+    std::copy(keys + pos + 1, keys + block->count, keys + pos);
+
+    encode(block, keys, block->count - 1);
+    refresh(root, block->base);
+
+    if(block->count >= B / 4)
+        return true;
+
+    // A small block is merged into a neighbour, if the two fit in one block:
+    block_node* next = nextBlock(block->base);
+
+    if(next && block->count + next->count <= B){
+
+        mergeBlocks(block, next);
+        return true;
+    }
+
+    block_node* prev = prevBlock(block->base);
+
+    if(prev && prev->count + block->count <= B)
+        mergeBlocks(prev, block);
+
+    return true;
+}
+
+
+template <typename T, size_t B>
+bool
+avl_compressed<T, B>::contains(const T& element) const{
+
+    if(root == nullptr)
+        return false;
+
+    block_node* block = findBlock(element);
+
+    return foundAt(block, lowerBound(block, element), element);
+}
+
+
+/* The keys of the blocks before the key's block are counted on the way down */
+template <typename T, size_t B>
+size_t
+avl_compressed<T, B>::rank(const T& key) const{
+
+    size_t before = 0, block_before = 0;
+    block_node* iter = root;
+    block_node* block = nullptr;
+
+    while(iter){
+
+        if(key < iter->base){
+            iter = iter->left;
+            continue;
+        }
+
+        block = iter;
+        block_before = before + totalOf(iter->left);
+        before = block_before + iter->count;
+        iter = iter->right;
+    }
+
+    if(block == nullptr)
+        throw key_not_exist<T>(key);
+
+    size_t pos = lowerBound(block, key);
+
+    if(!foundAt(block, pos, key))
+        throw key_not_exist<T>(key);
+
+    return block_before + pos + 1;
+}
+
+
+/* Like avl::select, an index out of range gives the min or the max */
+template <typename T, size_t B>
+T
+avl_compressed<T, B>::select(size_t index) const{
+
+    if(root == nullptr)
+        throw tree_is_empty();
+
+    if(index == 0)
+        return getMin();
+
+    if(index > tree_size)
+        return getMax();
+
+    block_node* iter = root;
+
+    while(true){
+
+        size_t left = totalOf(iter->left);
+
+        if(index <= left){
+            iter = iter->left;
+            continue;
+        }
+
+        if(index <= left + iter->count)
+            return keyAt(iter, index - left - 1);
+
+        index -= left + iter->count;
+        iter = iter->right;
+    }
+}
+
+
+template <typename T, size_t B>
+T
+avl_compressed<T, B>::getMin() const{
+
+    if(root == nullptr)
+        throw tree_is_empty();
+
+    block_node* iter = root;
+
+    while(iter->left)
+        iter = iter->left;
+
+    return iter->base;
+}
+
+template <typename T, size_t B>
+T
+avl_compressed<T, B>::getMax() const{
+
+    if(root == nullptr)
+        throw tree_is_empty();
+
+    block_node* iter = root;
+
+    while(iter->right)
+        iter = iter->right;
+
+    return keyAt(iter, iter->count - 1);
+}
+
+
+template <typename T, size_t B>
+size_t
+avl_compressed<T, B>::size() const{
+    return tree_size;
+}
+
+template <typename T, size_t B>
+bool
+avl_compressed<T, B>::empty() const{
+    return tree_size == 0;
+}
+
+
+template <typename T, size_t B>
+std::vector<T>
+avl_compressed<T, B>::getAll() const{
+
+    std::vector<T> all;
+    all.reserve(tree_size);
+
+    collect(root, all);
+    return all;
+}
+
+
+template <typename T, size_t B>
+size_t
+avl_compressed<T, B>::block_count() const{
+
+    size_t count = 0;
+
+    for(block_node* iter = root ? findBlock(getMin()) : nullptr; iter; iter = nextBlock(iter->base))
+        count++;
+
+    return count;
+}
+
+
+template <typename T, size_t B>
+size_t
+avl_compressed<T, B>::memory_bytes() const{
+    return sizeof(*this) + bytesOf(root);
+}
+
+
+/*   ***   iterator functions   ***   */
+
+template <typename T, size_t B>
+typename avl_compressed<T, B>::iterator
+avl_compressed<T, B>::begin() const{
+
+    block_node* first = root;
+
+    while(first && first->left)
+        first = first->left;
+
+    return iterator(this, first);
+}
+
+template <typename T, size_t B>
+typename avl_compressed<T, B>::iterator
+avl_compressed<T, B>::end() const{
+    return iterator(this, nullptr);
+}
+
+
+/*   ***   Blocks   ***   */
+
+template <typename T, size_t B>
+typename avl_compressed<T, B>::block_node*
+avl_compressed<T, B>::newBlock(const T* keys, size_t count) const{
+
+    block_node* block = new block_node;
+
+    encode(block, keys, count);
+    block->total = count;
+
+    return block;
+}
+
+
+/* 'keys' is sorted. The offset type is picked by the range of the block */
+template <typename T, size_t B>
+void
+avl_compressed<T, B>::encode(block_node* block, const T* keys, size_t count) const{
+
+    U base = U(keys[0]);
+    U range = U(keys[count - 1]) - base;
+
+    auto fill = [&](auto offset){
+
+        std::vector<decltype(offset)> offsets(count);
+
+        for(size_t i = 0; i < count; i++)
+            offsets[i] = decltype(offset)(U(keys[i]) - base);
+
+        block->offsets = std::move(offsets);
+    };
+
+    if(range <= 0xFFu)
+        fill(uint8_t());
+    else if(range <= 0xFFFFu)
+        fill(uint16_t());
+    else if(uint64_t(range) <= 0xFFFFFFFFu)
+        fill(uint32_t());
+    else
+        fill(uint64_t());
+
+    block->base = keys[0];
+    block->count = count;
+}
+
+
+template <typename T, size_t B>
+void
+avl_compressed<T, B>::decode(const block_node* block, T* out) const{
+
+    U base = U(block->base);
+
+    std::visit([&](const auto& offsets){
+
+        for(size_t i = 0; i < offsets.size(); i++)
+            out[i] = T(base + U(offsets[i]));
+
+    }, block->offsets);
+}
+
+
+template <typename T, size_t B>
+T
+avl_compressed<T, B>::keyAt(const block_node* block, size_t pos) const{
+
+    return std::visit([&](const auto& offsets){
+        return T(U(block->base) + U(offsets[pos]));
+    }, block->offsets);
+}
+
+
+template <typename T, size_t B>
+size_t
+avl_compressed<T, B>::lowerBound(const block_node* block, const T& key) const{
+
+    if(key < block->base)
+        return 0;
+
+    U target = U(key) - U(block->base);
+
+    // branch-free, so the loop is vectorized:
+    return std::visit([&](const auto& offsets){
+
+        size_t count = 0;
+
+        for(size_t i = 0; i < offsets.size(); i++)
+            count += (U(offsets[i]) < target);
+
+        return count;
+
+    }, block->offsets);
+}
+
+
+template <typename T, size_t B>
+bool
+avl_compressed<T, B>::foundAt(const block_node* block, size_t pos, const T& key) const{
+    return pos < block->count && keyAt(block, pos) == key;
+}
+
+
+/* 'upper' follows 'lower' and they fit in one block. 'upper' is freed */
+template <typename T, size_t B>
+void
+avl_compressed<T, B>::mergeBlocks(block_node* lower, block_node* upper){
+
+    T keys[B + 1];
+    size_t count = lower->count + upper->count;
+
+    decode(lower, keys);
+    decode(upper, keys + lower->count);
+
+    // The nodes keep their identity through the rotations, so 'lower' stays valid:
+    root = removeNode(root, upper->base);
+
+    encode(lower, keys, count);
+    refresh(root, lower->base);
+}
+
+
+/*   ***   Index lookup   ***   */
+
+template <typename T, size_t B>
+typename avl_compressed<T, B>::block_node*
+avl_compressed<T, B>::findBlock(const T& key) const{
+
+    block_node* iter = root;
+    block_node* candidate = nullptr;
+    block_node* first = nullptr;
+
+    while(iter){
+
+        if(key < iter->base){
+
+            first = iter;
+            iter = iter->left;
+        }
+        else{
+            candidate = iter;
+            iter = iter->right;
+        }
+    }
+
+    return candidate ? candidate : first;
+}
+
+
+template <typename T, size_t B>
+typename avl_compressed<T, B>::block_node*
+avl_compressed<T, B>::nextBlock(const T& base) const{
+
+    block_node* iter = root;
+    block_node* next = nullptr;
+
+    while(iter){
+
+        if(base < iter->base){
+
+            next = iter;
+            iter = iter->left;
+        }
+        else{
+            iter = iter->right;
+        }
+    }
+
+    return next;
+}
+
+
+template <typename T, size_t B>
+typename avl_compressed<T, B>::block_node*
+avl_compressed<T, B>::prevBlock(const T& base) const{
+
+    block_node* iter = root;
+    block_node* prev = nullptr;
+
+    while(iter){
+
+        if(iter->base < base){
+
+            prev = iter;
+            iter = iter->right;
+        }
+        else{
+            iter = iter->left;
+        }
+    }
+
+    return prev;
+}
+
+
+/*   ***   Index update   ***   */
+
+/* The height of a null son is -1 */
+template <typename T, size_t B>
+int
+avl_compressed<T, B>::heightOf(const block_node* iter){
+    return iter ? iter->height : -1;
+}
+
+template <typename T, size_t B>
+size_t
+avl_compressed<T, B>::totalOf(const block_node* iter){
+    return iter ? iter->total : 0;
+}
+
+template <typename T, size_t B>
+void
+avl_compressed<T, B>::update(block_node* iter){
+
+    iter->height = 1 + std::max(heightOf(iter->left), heightOf(iter->right));
+    iter->total = iter->count + totalOf(iter->left) + totalOf(iter->right);
+}
+
+
+/*
+ *  Unlike the rotations of avl, the nodes move and not the keys:
+ *  a block is too big to swap, and mergeBlocks() holds a node across a removal.
+ */
+template <typename T, size_t B>
+typename avl_compressed<T, B>::block_node*
+avl_compressed<T, B>::rotateLeft(block_node* iter){
+
+    block_node* son = iter->right;
+
+    iter->right = son->left;
+    son->left = iter;
+
+    update(iter);
+    update(son);
+
+    return son;
+}
+
+template <typename T, size_t B>
+typename avl_compressed<T, B>::block_node*
+avl_compressed<T, B>::rotateRight(block_node* iter){
+
+    block_node* son = iter->left;
+
+    iter->left = son->right;
+    son->right = iter;
+
+    update(iter);
+    update(son);
+
+    return son;
+}
+
+
+template <typename T, size_t B>
+typename avl_compressed<T, B>::block_node*
+avl_compressed<T, B>::rebalance(block_node* iter){
+
+    update(iter);
+
+    int balance_f = heightOf(iter->left) - heightOf(iter->right);
+
+    if(balance_f == 2){
+
+        // LR-rolling, which is RR(left son) + LL
+        if(heightOf(iter->left->left) < heightOf(iter->left->right))
+            iter->left = rotateLeft(iter->left);
+
+        return rotateRight(iter);
+    }
+
+    if(balance_f == -2){
+
+        // RL-rolling, which is LL(right son) + RR
+        if(heightOf(iter->right->right) < heightOf(iter->right->left))
+            iter->right = rotateRight(iter->right);
+
+        return rotateLeft(iter);
+    }
+
+    return iter;
+}
+
+
+template <typename T, size_t B>
+typename avl_compressed<T, B>::block_node*
+avl_compressed<T, B>::insertNode(block_node* iter, block_node* fresh){
+
+    if(iter == nullptr)
+        return fresh;
+
+    if(fresh->base < iter->base)
+        iter->left = insertNode(iter->left, fresh);
+    else
+        iter->right = insertNode(iter->right, fresh);
+
+    return rebalance(iter);
+}
+
+
+template <typename T, size_t B>
+typename avl_compressed<T, B>::block_node*
+avl_compressed<T, B>::removeNode(block_node* iter, T base){
+
+    if(base < iter->base){
+
+        iter->left = removeNode(iter->left, base);
+        return rebalance(iter);
+    }
+
+    if(iter->base < base){
+
+        iter->right = removeNode(iter->right, base);
+        return rebalance(iter);
+    }
+
+    block_node* left = iter->left;
+    block_node* right = iter->right;
+
+    // node's D'tor frees the sons:
+    iter->left = iter->right = nullptr;
+    delete iter;
+
+    if(right == nullptr)
+        return left;
+
+    block_node* following;
+    right = detachMin(right, following);
+
+    following->left = left;
+    following->right = right;
+
+    return rebalance(following);
+}
+
+
+template <typename T, size_t B>
+typename avl_compressed<T, B>::block_node*
+avl_compressed<T, B>::detachMin(block_node* iter, block_node*& min_node){
+
+    if(iter->left == nullptr){
+
+        min_node = iter;
+
+        block_node* right = iter->right;
+        iter->right = nullptr;
+
+        return right;
+    }
+
+    iter->left = detachMin(iter->left, min_node);
+
+    return rebalance(iter);
+}
+
+
+template <typename T, size_t B>
+void
+avl_compressed<T, B>::refresh(block_node* iter, const T& base){
+
+    if(base < iter->base)
+        refresh(iter->left, base);
+    else if(iter->base < base)
+        refresh(iter->right, base);
+
+    update(iter);
+}
+
+
+/* [first, last) of the sorted blocks. The middle one is the root */
+template <typename T, size_t B>
+typename avl_compressed<T, B>::block_node*
+avl_compressed<T, B>::buildIndex(std::vector<block_node*>& blocks, size_t first, size_t last){
+
+    if(first == last)
+        return nullptr;
+
+    size_t mid = first + (last - first) / 2;
+    block_node* iter = blocks[mid];
+
+    iter->left = buildIndex(blocks, first, mid);
+    iter->right = buildIndex(blocks, mid + 1, last);
+    update(iter);
+
+    return iter;
+}
+
+
+template <typename T, size_t B>
+typename avl_compressed<T, B>::block_node*
+avl_compressed<T, B>::clone(const block_node* iter) const{
+
+    if(iter == nullptr)
+        return nullptr;
+
+    block_node* copy = new block_node;
+
+    copy->base = iter->base;
+    copy->count = iter->count;
+    copy->total = iter->total;
+    copy->height = iter->height;
+    copy->offsets = iter->offsets;
+    copy->left = clone(iter->left);
+    copy->right = clone(iter->right);
+
+    return copy;
+}
+
+
+template <typename T, size_t B>
+void
+avl_compressed<T, B>::collect(const block_node* iter, std::vector<T>& out) const{
+
+    if(iter == nullptr)
+        return;
+
+    collect(iter->left, out);
+
+    size_t first = out.size();
+    out.resize(first + iter->count);
+    decode(iter, out.data() + first);
+
+    collect(iter->right, out);
+}
+
+
+template <typename T, size_t B>
+size_t
+avl_compressed<T, B>::bytesOf(const block_node* iter) const{
+
+    if(iter == nullptr)
+        return 0;
+
+    size_t offset_bytes = std::visit([](const auto& offsets){
+        return offsets.capacity() * sizeof(offsets[0]);
+    }, iter->offsets);
+
+    return sizeof(block_node) + offset_bytes + bytesOf(iter->left) + bytesOf(iter->right);
+}
+
+
+#endif /* AVL_COMPRESSED_H_ */
@@ -16,10 +16,10 @@ class avl_exceptions : public std::exception {};
 class tree_is_empty : public avl_exceptions {
 /*
  Throw from:
-        select(), min(), max()
+        select(), select_many(), quantiles(), min(), max(), popMin(), popMax()
 
  Can be thrown following a call to:
-        select(), min(), max()
+        select(), select_many(), quantiles(), min(), max(), popMin(), popMax()
 */
 };
 
@@ -27,7 +27,8 @@ class tree_is_empty : public avl_exceptions {
 template <class T>
 class avl_key_error : public avl_exceptions {
     
-    const T& key;
+    /* A copy: the key passed to insert/remove is often a temporary */
+    T key;
     KEY_ERROR error_type;
 
 public:
@@ -49,7 +50,7 @@ public:
         }
     }
     
-    const T& getKey(){
+    const T& getKey() const{
         return key;
     }
 };
@@ -60,6 +61,7 @@ class non_unique_key : public avl_key_error<T> {
 /*
  Throw from:
         avl::SetFunctor::operator()
+        static_avl C'tor (a compile error when it's constexpr)
 
  Can be thrown following a call to:
         avl<T>& operator=(const avl& src);
@@ -78,10 +80,12 @@ template <class T>
 class key_not_exist : public avl_key_error<T> {
 /*
  Throw from:
-        remove(), rank(), getRef()
+        remove(), rank(), rank_many(), getRef()
 
  Can be thrown following a call to:
-        remove(), rank(), getRef()
+        remove(), rank(), rank_many(), getRef()
+
+ try_remove() and find() report a missing key without throwing.
 */
 public:
     key_not_exist(const T& key)
@@ -97,6 +101,8 @@ class key_already_exists : public avl_key_error<T> {
 
  Can be thrown following a call to:
         insert()
+
+ try_insert() reports an existing key without throwing.
 */
 public:
     key_already_exists(const T& key) 
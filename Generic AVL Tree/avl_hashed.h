@@ -0,0 +1,430 @@
+#ifndef AVL_HASHED_H_
+#define AVL_HASHED_H_
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "avl_impl.h"
+
+
+/*
+ *  avl with a side hash index, for membership-heavy workloads.
+ *
+ *  contains() & getRef() probe an open-addressing table (linear probing,
+ *  load factor at most 3/4) in O(1) expected, instead of walking O(log(n)) nodes.
+ *  rank, select, min, max & the iteration still use the tree.
+ *
+ *  The table holds copies of the keys, not node pointers: the rotations
+ *  move the keys between the nodes, so a node pointer would go stale.
+ *  The price is a second copy of every key plus its hash (see index_bytes()).
+ *  The table grows with the tree but never shrinks; clear() frees it.
+ *
+ *  Hash must agree with Comp: keys that Comp finds equivalent get the same hash.
+ *  Every update goes through this class, so the tree is only given out as const.
+ */
+
+template <typename T, typename Comp = std::less<T>, typename Hash = std::hash<T>,
+          typename Balance = avl_balance>
+class avl_hashed {
+    using tree_type = avl<T, Comp, avl_no_stats, Balance>;
+
+    /* 'tag' is the hash with the low bit set, 0 marks an empty slot */
+    struct slot {
+        size_t tag = 0;
+        T key;
+    };
+
+    tree_type tree;
+    Comp comp;
+    Hash hash;
+
+    std::vector<slot> table;        // size is a power of 2, or 0
+    int table_bits;
+    size_t count;
+
+public:
+// Constractors:
+    explicit avl_hashed(const Comp& comp = Comp(), const Hash& hash = Hash());
+    explicit avl_hashed(std::vector<T> elements, bool sorted = false,
+                        const Comp& comp = Comp(), const Hash& hash = Hash());
+
+// Operations:
+    void insert(const T& element);
+    void remove(const T& element);
+    bool try_insert(const T& element);
+    bool try_remove(const T& element);
+    void clear();
+
+    /* O(1) expected */
+    bool contains(const T& element) const;
+    const T& getRef(const T& key) const;
+
+    size_t rank(const T& key) const;
+    const T& select(size_t index) const;
+    const T& getMin() const;
+    const T& getMax() const;
+
+    size_t size() const;
+    bool empty() const;
+    std::vector<T> getAll() const;
+
+    /* For every other read-only operation */
+    const tree_type& ordered() const;
+
+    /* Memory of the table alone (the tree's is in ordered().stats()) */
+    size_t index_bytes() const;
+
+// const-iterator (the tree's):
+    typename tree_type::iterator begin();
+    typename tree_type::iterator end();
+
+private:
+    bool less(const T& k1, const T& k2) const;
+    size_t tagOf(const T& key) const;
+    size_t home(size_t tag) const;
+
+    /* The slot of 'key', or the empty slot where it would go */
+    size_t probe(const T& key, size_t tag) const;
+
+    /* Grows the table for one more key. Called before the tree changes,
+     * so a bad_alloc leaves the tree & the table as they were */
+    void indexReserve();
+    void indexInsert(const T& key);
+    void indexRemove(const T& key);
+    void indexBuild(const std::vector<T>& keys);
+    void resize(int bits);
+};
+
+
+/*   ***   Constructors   ***   */
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+avl_hashed<T, Comp, Hash, Balance>::avl_hashed(const Comp& comp, const Hash& hash)
+        : tree(comp), comp(comp), hash(hash), table_bits(0), count(0){
+}
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+avl_hashed<T, Comp, Hash, Balance>::avl_hashed(std::vector<T> elements, bool sorted,
+                                               const Comp& comp, const Hash& hash)
+        : tree(std::move(elements), comp, sorted), comp(comp), hash(hash), table_bits(0), count(0){
+
+    // a duplicate key was thrown by the C'tor of avl (non_unique_key):
+    indexBuild(tree.getAll());
+}
+
+
+/*   ***   Operations   ***   */
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+void
+avl_hashed<T, Comp, Hash, Balance>::insert(const T& element){
+
+    if(contains(element))
+        throw key_already_exists<T>(element);
+
+    indexReserve();
+    tree.insert(element);
+    indexInsert(element);
+}
+
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+void
+avl_hashed<T, Comp, Hash, Balance>::remove(const T& element){
+
+    if(!contains(element))
+        throw key_not_exist<T>(element);
+
+    tree.remove(element);
+    indexRemove(element);
+}
+
+
+/* The table answers first, so a duplicate costs no descent */
+template <typename T, typename Comp, typename Hash, typename Balance>
+bool
+avl_hashed<T, Comp, Hash, Balance>::try_insert(const T& element){
+
+    if(contains(element))
+        return false;
+
+    indexReserve();
+    tree.try_insert(element);
+    indexInsert(element);
+
+    return true;
+}
+
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+bool
+avl_hashed<T, Comp, Hash, Balance>::try_remove(const T& element){
+
+    if(!contains(element))
+        return false;
+
+    tree.try_remove(element);
+    indexRemove(element);
+
+    return true;
+}
+
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+void
+avl_hashed<T, Comp, Hash, Balance>::clear(){
+
+    tree = tree_type(comp);
+    table.clear();
+    table_bits = 0;
+    count = 0;
+}
+
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+bool
+avl_hashed<T, Comp, Hash, Balance>::contains(const T& element) const{
+
+    if(count == 0)
+        return false;
+
+    return table[probe(element, tagOf(element))].tag != 0;
+}
+
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+const T&
+avl_hashed<T, Comp, Hash, Balance>::getRef(const T& key) const{
+
+    if(count == 0)
+        throw key_not_exist<T>(key);
+
+    const slot& found = table[probe(key, tagOf(key))];
+
+    if(found.tag == 0)
+        throw key_not_exist<T>(key);
+
+    return found.key;
+}
+
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+size_t
+avl_hashed<T, Comp, Hash, Balance>::rank(const T& key) const{
+    return tree.rank(key);
+}
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+const T&
+avl_hashed<T, Comp, Hash, Balance>::select(size_t index) const{
+    return tree.select(index);
+}
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+const T&
+avl_hashed<T, Comp, Hash, Balance>::getMin() const{
+    return tree.getMin();
+}
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+const T&
+avl_hashed<T, Comp, Hash, Balance>::getMax() const{
+    return tree.getMax();
+}
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+size_t
+avl_hashed<T, Comp, Hash, Balance>::size() const{
+    return count;
+}
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+bool
+avl_hashed<T, Comp, Hash, Balance>::empty() const{
+    return count == 0;
+}
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+std::vector<T>
+avl_hashed<T, Comp, Hash, Balance>::getAll() const{
+    return tree.getAll();
+}
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+const typename avl_hashed<T, Comp, Hash, Balance>::tree_type&
+avl_hashed<T, Comp, Hash, Balance>::ordered() const{
+    return tree;
+}
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+size_t
+avl_hashed<T, Comp, Hash, Balance>::index_bytes() const{
+    return table.capacity() * sizeof(slot);
+}
+
+
+/*   ***   iterator functions   ***   */
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+typename avl_hashed<T, Comp, Hash, Balance>::tree_type::iterator
+avl_hashed<T, Comp, Hash, Balance>::begin(){
+    return tree.begin();
+}
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+typename avl_hashed<T, Comp, Hash, Balance>::tree_type::iterator
+avl_hashed<T, Comp, Hash, Balance>::end(){
+    return tree.end();
+}
+
+
+/*   ***   Private methods   ***   */
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+bool
+avl_hashed<T, Comp, Hash, Balance>::less(const T& k1, const T& k2) const{
+    return avl_comp_traits<T, Comp>::less(comp, k1, k2);
+}
+
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+size_t
+avl_hashed<T, Comp, Hash, Balance>::tagOf(const T& key) const{
+    return size_t(hash(key)) | 1;
+}
+
+
+/* Fibonacci hashing: the top bits of the product, so std::hash<int> (the identity) spreads too */
+template <typename T, typename Comp, typename Hash, typename Balance>
+size_t
+avl_hashed<T, Comp, Hash, Balance>::home(size_t tag) const{
+    return size_t((uint64_t(tag) * 0x9E3779B97F4A7C15ull) >> (64 - table_bits));
+}
+
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+size_t
+avl_hashed<T, Comp, Hash, Balance>::probe(const T& key, size_t tag) const{
+
+    size_t mask = table.size() - 1;
+    size_t pos = home(tag);
+
+    // the key is compared only when the whole hash matches:
+    while(table[pos].tag != 0){
+
+        if(table[pos].tag == tag && !less(table[pos].key, key) && !less(key, table[pos].key))
+            return pos;
+
+        pos = (pos + 1) & mask;
+    }
+
+    return pos;
+}
+
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+void
+avl_hashed<T, Comp, Hash, Balance>::indexReserve(){
+
+    if((count + 1) * 4 > table.size() * 3)
+        resize(table_bits ? table_bits + 1 : 4);
+}
+
+
+/* The room is reserved, so only the copy of the key can throw: then the tree gives it back */
+template <typename T, typename Comp, typename Hash, typename Balance>
+void
+avl_hashed<T, Comp, Hash, Balance>::indexInsert(const T& key){
+
+    indexReserve();
+
+    size_t tag = tagOf(key);
+    slot& target = table[probe(key, tag)];
+
+    try{
+        target.key = key;
+    }
+    catch(...){
+        tree.try_remove(key);
+        throw;
+    }
+
+    target.tag = tag;
+    count++;
+}
+
+
+/* Backward-shift deletion: no tombstones, so a probe always ends at a real hole */
+template <typename T, typename Comp, typename Hash, typename Balance>
+void
+avl_hashed<T, Comp, Hash, Balance>::indexRemove(const T& key){
+
+    size_t mask = table.size() - 1;
+    size_t hole = probe(key, tagOf(key));
+    size_t next = (hole + 1) & mask;
+
+    while(table[next].tag != 0){
+
+        // an entry may move back to the hole only if its home isn't in (hole, next]:
+        size_t distance = (next - home(table[next].tag)) & mask;
+
+        if(distance >= ((next - hole) & mask)){
+
+            table[hole] = std::move(table[next]);
+            hole = next;
+        }
+
+        next = (next + 1) & mask;
+    }
+
+    table[hole].tag = 0;
+    table[hole].key = T();
+    count--;
+}
+
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+void
+avl_hashed<T, Comp, Hash, Balance>::indexBuild(const std::vector<T>& keys){
+
+    int bits = 4;
+    while((size_t(1) << bits) * 3 < keys.size() * 4)
+        bits++;
+
+    table.clear();
+    count = 0;
+    resize(bits);
+
+    for(const T& key : keys)
+        indexInsert(key);
+}
+
+
+template <typename T, typename Comp, typename Hash, typename Balance>
+void
+avl_hashed<T, Comp, Hash, Balance>::resize(int bits){
+
+    std::vector<slot> old_table(size_t(1) << bits);
+    old_table.swap(table);
+    table_bits = bits;
+
+    size_t mask = table.size() - 1;
+
+    for(slot& entry : old_table){
+
+        if(entry.tag == 0)
+            continue;
+
+        size_t pos = home(entry.tag);
+
+        while(table[pos].tag != 0)
+            pos = (pos + 1) & mask;
+
+        table[pos] = std::move(entry);
+    }
+}
+
+
+#endif /* AVL_HASHED_H_ */
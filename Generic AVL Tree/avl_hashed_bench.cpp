@@ -0,0 +1,68 @@
+/*
+ *  Memory vs latency of the side hash index (avl_hashed.h).
+ *
+ *  For each size, the same random keys go into an avl and into an avl_hashed,
+ *  then both answer the same mix of contains() calls (half hits, half misses).
+ *
+ *  Build & run:
+ *      g++ -std=c++17 -O2 -DNDEBUG avl_hashed_bench.cpp -o avl_hashed_bench
+ *      ./avl_hashed_bench
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "avl_hashed.h"
+
+
+template <typename Set>
+double nsPerLookup(const Set& set, const std::vector<int>& queries, size_t& hits){
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(int key : queries)
+        hits += set.contains(key);
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / queries.size();
+}
+
+
+int main(){
+
+    std::mt19937 gen(2024);
+    const size_t num_queries = 2000000;
+
+    std::printf("%10s %12s %12s %12s %12s %12s\n",
+                "keys", "avl ns", "hashed ns", "avl MB", "index MB", "speedup");
+
+    for(size_t size = 1000; size <= 4000000; size *= 4){
+
+        // even keys are stored, odd keys are the misses:
+        std::vector<int> keys(size);
+        for(size_t i = 0; i < size; i++)
+            keys[i] = int(2 * i);
+
+        avl<int> tree(keys, true);
+        avl_hashed<int> hashed(keys, true);
+
+        std::vector<int> queries(num_queries);
+        for(int& key : queries)
+            key = int(gen() % (2 * size));
+
+        size_t hits = 0;
+        double tree_ns = nsPerLookup(tree, queries, hits);
+        double hashed_ns = nsPerLookup(hashed, queries, hits);
+
+        double tree_mb = tree.stats().total_bytes / 1e6;
+        double index_mb = hashed.index_bytes() / 1e6;
+
+        std::printf("%10zu %12.1f %12.1f %12.2f %12.2f %11.1fx   (%zu)\n",
+                    size, tree_ns, hashed_ns, tree_mb, index_mb, tree_ns / hashed_ns, hits);
+    }
+
+    return 0;
+}
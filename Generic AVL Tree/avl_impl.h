@@ -6,38 +6,50 @@
 
 /*   ***   Constructors   ***   */
 
-template <typename T, typename Comp>
-avl<T, Comp>::avl() 
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>::avl() 
         : avl(Comp()) {
 }
 
-template <typename T, typename Comp>
-avl<T, Comp>::avl(const Comp& comp)
-        : root(nullptr), min(nullptr), max(nullptr), tree_size(0), key_comp(comp){
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>::avl(const Comp& comp)
+        : avl_ebo<Comp, 1>(comp), root(nullptr), min(nullptr), max(nullptr), tree_size(0),
+          arena(nullptr){
 }
 
-template <typename T, typename Comp>
-avl<T, Comp>::avl(const avl& src) 
-        : avl(src.getAll(), src.key_comp, true){
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>::avl(const avl& src) 
+        : avl(src.getAll(), src.keyComp(), true){
 }
 
+/* The counters of the Stats policy start over, as in a copy */
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>::avl(avl&& src) noexcept(std::is_nothrow_copy_constructible<Comp>::value)
+        : avl_ebo<Comp, 1>(src.keyComp()), root(src.root), min(src.min), max(src.max), 
+          tree_size(src.tree_size), arena(src.arena){
+    
+    src.root = src.min = src.max = nullptr;
+    src.tree_size = 0;
+    src.arena = nullptr;
+}
 
-template <typename T, typename Comp>
-avl<T, Comp>::avl(std::vector<T> elements, bool sorted)
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>::avl(std::vector<T> elements, bool sorted)
         : avl(elements, Comp(), sorted){
 }
 
 
-template <typename T, typename Comp>
-avl<T, Comp>::avl(std::vector<T> elements, const Comp& comp, bool sorted)
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>::avl(std::vector<T> elements, const Comp& comp, bool sorted)
         : avl(comp){
 
     buildAlmostCompleteTree(elements.size());
 
     if(!sorted)
-        std::sort(elements.begin(), elements.end(), comp);
+        std::sort(elements.begin(), elements.end(), avl_less_than<T, Comp>(keyComp()));
 
-    SetFunctor<T, Comp, vec_iter> functor(elements.begin(), elements.end(), key_comp);
+    SetFunctor<T, Comp, vec_iter> functor(elements.begin(), elements.end(), keyComp());
     inorderAux<SetFunctor<T, Comp, vec_iter>>(functor, root);
 
     updateMinAndMax();
@@ -45,21 +57,21 @@ avl<T, Comp>::avl(std::vector<T> elements, const Comp& comp, bool sorted)
 }
 
 
-template <typename T, typename Comp>
-avl<T, Comp>::avl(T* elements, size_t arr_size, bool sorted) 
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>::avl(T* elements, size_t arr_size, bool sorted) 
         : avl(elements, arr_size, Comp(), sorted){
 }
 
-template <typename T, typename Comp>
-avl<T, Comp>::avl(T* elements, size_t arr_size, const Comp& comp, bool sorted) 
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>::avl(T* elements, size_t arr_size, const Comp& comp, bool sorted) 
         : avl(comp){
     
     buildAlmostCompleteTree(arr_size);
 
     if(!sorted)
-        std::sort(elements, elements + arr_size, comp);
+        std::sort(elements, elements + arr_size, avl_less_than<T, Comp>(keyComp()));
     
-    SetFunctor<T, Comp, T*> functor(elements, elements + arr_size, key_comp);
+    SetFunctor<T, Comp, T*> functor(elements, elements + arr_size, keyComp());
     inorderAux<SetFunctor<T, Comp, T*>>(functor, root);
 
     updateMinAndMax();
@@ -67,160 +79,209 @@ avl<T, Comp>::avl(T* elements, size_t arr_size, const Comp& comp, bool sorted)
 }
 
 
-template <typename T, typename Comp>
-avl<T, Comp>::~avl(){
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>::~avl(){
     min = max = nullptr;
-    delete root;
+    deleteTree(root);
 }
 
 
-template <typename T, typename Comp>
-avl<T, Comp>& 
-avl<T, Comp>::operator=(const avl<T, Comp>& src){
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>& 
+avl<T, Comp, Stats, Balance>::operator=(const avl<T, Comp, Stats, Balance>& src){
     
     if(this == &src)
         return *this;
     
-    min = max = nullptr;
+    std::vector<T> copy_elem = src.getAll();
+    rebuild(copy_elem);
+    
+    return *this;
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>& 
+avl<T, Comp, Stats, Balance>::operator=(avl<T, Comp, Stats, Balance>&& src)
+        noexcept(std::is_nothrow_copy_assignable<Comp>::value){
+    
+    if(this == &src)
+        return *this;
+    
+    // frees the compact() block of this tree too:
     node<T>* to_delete = root;
-    root = nullptr;
-    delete to_delete;
+    resetRoot(nullptr);
+    deleteTree(to_delete);
     
-    std::vector<T> copy_elem = src.getAll();
-    buildAlmostCompleteTree(copy_elem.size());
+    this->avl_ebo<Comp, 1>::get() = src.keyComp();
+    
+    root = src.root;
+    min = src.min;
+    max = src.max;
+    tree_size = src.tree_size;
+    arena = src.arena;
+    
+    src.root = src.min = src.max = nullptr;
+    src.tree_size = 0;
+    src.arena = nullptr;
+    
+    return *this;
+}
 
-    SetFunctor<T, Comp, vec_iter> functor(copy_elem.begin(), copy_elem.end(), key_comp);
-    inorderAux<SetFunctor<T, Comp, vec_iter>>(functor, root);
 
-    updateMinAndMax();
-    tree_size = src.size();    
-    return *this;
+template <typename T, typename Comp, typename Stats, typename Balance>
+Comp 
+avl<T, Comp, Stats, Balance>::key_comp() const {
+    return keyComp();
 }
 
 
 /*   ***   Operations   ***   */
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 void 
-avl<T, Comp>::insert(T element){
+avl<T, Comp, Stats, Balance>::insert(T element){
 
     // if the tree is empty:
     if(root == nullptr){
         
-        root = new node<T>(element);
+        root = newNode(element);
         min = max = root;
         tree_size++;
         return;
     }
 
-    bool new_min_or_max = key_comp(element, min->key) || key_comp(max->key, element);
+    AVL_STATUS status = insertAux(root, element);
 
-    if(insertAux(root, element) == FAILURE){
+    if(status == FAILURE){
 
         throw key_already_exists<T>(element);
     }
-    if(new_min_or_max)
-        updateMinAndMax();
+
+    updateMinAndMax(status);
 
     tree_size++;
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 void 
-avl<T, Comp>::remove(const T element){
-    
-    node<T>* to_remove = find(element);
+avl<T, Comp, Stats, Balance>::remove(const T element){
     
-    if(to_remove == nullptr)
+    if(!try_remove(element))
         throw key_not_exist<T>(element);
-    
-    if(to_remove->left && to_remove->right){
-        
-        node<T>* following = to_remove->right;
-        
-        while(following->left)
-            following = following->left;
-        
-        T save_following_key = following->key;
-        remove(following->key);
-        
-        node<T>* change_to_following = find(element);
-        change_to_following->key = save_following_key;
-        return;
-    }
-
-    // It checks pointers equality
-    bool is_min_or_max = (to_remove == min) || (to_remove == max);
-    
-    if(to_remove->left){
-        
-        std::swap(to_remove->key, to_remove->left->key);
-        std::swap(to_remove->left, to_remove->right);
-    }
-    else if(to_remove->right){
-        
-        std::swap(to_remove->key, to_remove->right->key);
-        std::swap(to_remove->left, to_remove->right);
-    }
-    else if(keysEqual(root->key, element)){
-        
-        min = max = nullptr;
-        tree_size--;
-        node<T>* to_delete = root;
-        root = nullptr;
-        delete to_delete;
-        return;
-    }
-
-    removeLeaf(root, element);
-
-    if(is_min_or_max)
-        updateMinAndMax();
-        
-    tree_size--;
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 bool 
-avl<T, Comp>::contains(const T& element) const {
+avl<T, Comp, Stats, Balance>::contains(const T& element) const {
     
-    return find(element) != nullptr;
+    return findNode(element) != nullptr;
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 size_t 
-avl<T, Comp>::rank(const T& key) const {
-    
-    if(find(key) == nullptr)
-        throw key_not_exist<T>(key);
+avl<T, Comp, Stats, Balance>::rank(const T& key) const {
     
+    // A single descent like findNode(). The keys left of the path are counted on the way down
     size_t rank = 0;
+    size_t path_length = 0;
     node<T>* iter = root;
+    node<T>* candidate = nullptr;
     
     while(iter){
+        path_length++;
         
-        if(keysEqual(key, iter->key))
-            break;
+        int cmp = three_way_comp ? compare(key, iter->key) : (less(key, iter->key) ? -1 : 1);
         
-        if(key_comp(key, iter->key)){
+        if(cmp < 0){
             iter = iter->left;
             continue;
         }
         
-        iter = iter->right;
         rank += iter->w_left() + 1;
+        
+        if(cmp == 0){
+            candidate = iter;
+            break;
+        }
+        
+        if(!three_way_comp)
+            candidate = iter;
+        
+        iter = iter->right;
     }
+    statsPolicy().onSearch(path_length);
+    
+    if(candidate == nullptr || (!three_way_comp && less(candidate->key, key)))
+        throw key_not_exist<T>(key);
+    
+    // Nothing is added after the key itself: its right subtree is greater
+    return rank;
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+std::vector<T> 
+avl<T, Comp, Stats, Balance>::select_many(const std::vector<size_t>& sorted_indices) const {
+    
+    if(root == nullptr)
+        throw tree_is_empty();
+    
+    // Out of range indices are clamped to the min / max
+    std::vector<size_t> indices(sorted_indices);
+    
+    for(size_t i = 0; i < indices.size(); i++)
+        indices[i] = std::min(std::max(indices[i], size_t(1)), tree_size);
+    
+    std::vector<T> ret_val(indices.size());
+    
+    if(!indices.empty())
+        selectManyAux(root, indices.data(), indices.data() + indices.size(), 0, 
+                      ret_val.data(), indices.data());
+    
+    return ret_val;
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+std::vector<T> 
+avl<T, Comp, Stats, Balance>::quantiles(size_t k) const {
+    
+    if(root == nullptr)
+        throw tree_is_empty();
+    
+    if(k == 0)
+        k = 1;
+    
+    // Nearest-rank cut points, from the min (i = 0) to the max (i = k):
+    std::vector<size_t> indices(k + 1);
+    
+    for(size_t i = 0; i <= k; i++)
+        indices[i] = 1 + (i * (tree_size - 1)) / k;
+    
+    return select_many(indices);
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+std::vector<size_t> 
+avl<T, Comp, Stats, Balance>::rank_many(const std::vector<T>& sorted_keys) const {
+    
+    std::vector<size_t> ret_val(sorted_keys.size());
     
-    return rank + iter->w_left() + 1;
+    if(!sorted_keys.empty())
+        rankManyAux(root, sorted_keys.data(), sorted_keys.data() + sorted_keys.size(), 0,
+                    ret_val.data(), sorted_keys.data());
+    
+    return ret_val;
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 const T& 
-avl<T, Comp>::select(size_t index) const {
+avl<T, Comp, Stats, Balance>::select(size_t index) const {
     
     if(root == nullptr)
         throw tree_is_empty();
@@ -229,9 +290,9 @@ avl<T, Comp>::select(size_t index) const {
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 T& 
-avl<T, Comp>::getRef(const T& key){
+avl<T, Comp, Stats, Balance>::getRef(const T& key){
 
 /*
  *  When using this method, 
@@ -239,66 +300,86 @@ avl<T, Comp>::getRef(const T& key){
  *  comparison between keys at this specific tree.
  */
 
-    node<T>* iter = root;
+    node<T>* iter = findNode(key);
     
-    while(iter){
-        if(keysEqual(key, iter->key))
-            return iter->key;
-        
-        if(key_comp(key, iter->key))
-            iter = iter->left;
-        else
-            iter = iter->right;
-    }
+    if(iter == nullptr)
+        throw key_not_exist<T>(key);
 
-    throw key_not_exist<T>(key);
+    return iter->key;
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 const T& 
-avl<T, Comp>::getMin() const {
+avl<T, Comp, Stats, Balance>::getMin() const {
     return min->key;
 }
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 const T& 
-avl<T, Comp>::getMax() const {
+avl<T, Comp, Stats, Balance>::getMax() const {
     return max->key;
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 T 
-avl<T, Comp>::popMin() {
-    // TODO
-    // Effective implementation is required here!
+avl<T, Comp, Stats, Balance>::popMin() {
+    
+    if(root == nullptr)
+        throw tree_is_empty();
+    
+    node<T>* old_root = root;
+    node<T>* old_right = root->right;
+    
+    T popped = popSpine(false);
+    
+    // Unless the root was rolled, the right spine wasn't touched:
+    if(root == old_root && root->right == old_right)
+        updateMin();
+    else
+        updateMinAndMax();
+    
+    return popped;
 }
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 T 
-avl<T, Comp>::popMax() {
-    // TODO
-    // Effective implementation is required here!
+avl<T, Comp, Stats, Balance>::popMax() {
+    
+    if(root == nullptr)
+        throw tree_is_empty();
+    
+    node<T>* old_root = root;
+    node<T>* old_left = root->left;
+    
+    T popped = popSpine(true);
+    
+    if(root == old_root && root->left == old_left)
+        updateMax();
+    else
+        updateMinAndMax();
+    
+    return popped;
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 size_t 
-avl<T, Comp>::size() const {
+avl<T, Comp, Stats, Balance>::size() const {
     return tree_size;
 }
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 bool 
-avl<T, Comp>::empty() const {
+avl<T, Comp, Stats, Balance>::empty() const {
     return tree_size == 0;
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 std::vector<T> 
-avl<T, Comp>::getAll() const {
+avl<T, Comp, Stats, Balance>::getAll() const {
     
     GetFunctor<T> ret_val;
     
@@ -308,187 +389,1038 @@ avl<T, Comp>::getAll() const {
 }
 
 
-/*   ***   iterator functions   ***   */
+/*   ***   Bounded insert   ***   */
 
-template <typename T, typename Comp>
-avl<T, Comp>::iterator::iterator() 
-        : avl_iterator<T>(nullptr){
+template <typename T, typename Comp, typename Stats, typename Balance>
+bool 
+avl<T, Comp, Stats, Balance>::offer(T element, size_t capacity, AVL_EVICT evict){
+    
+    if(capacity == 0)
+        return false;
+    
+    bool evict_max = (evict == EVICT_MAX);
+    
+    // A full tree rejects in O(1) what it would evict right away (and the equal key):
+    if(tree_size >= capacity){
+        
+        if(evict_max ? !less(element, max->key) : !less(min->key, element))
+            return false;
+    }
+    
+    if(root == nullptr){
+        
+        root = newNode(element);
+        min = max = root;
+        tree_size++;
+        return true;
+    }
+    
+    AVL_STATUS status = insertAux(root, element);
+    
+    if(status == FAILURE)
+        return false;
+    
+    updateMinAndMax(status);
+    tree_size++;
+    
+    // Walks down the spine with no comparison, and rescans the popped side only:
+    if(tree_size > capacity)
+        evict_max ? popMax() : popMin();
+    
+    return true;
 }
 
-template <typename T, typename Comp>
-avl<T, Comp>::iterator::iterator(node<T>* root) 
-        : avl_iterator<T>(root){
-}
 
-template <typename T, typename Comp>
-typename avl<T, Comp>::iterator 
-avl<T, Comp>::begin() noexcept{
+template <typename T, typename Comp, typename Stats, typename Balance>
+size_t 
+avl<T, Comp, Stats, Balance>::shrink_to(size_t capacity, AVL_EVICT evict){
     
-    iterator ret_val(this->root);
+    size_t old_size = tree_size;
     
-    ret_val.init_for_begin();
+    while(tree_size > capacity)
+        evict == EVICT_MAX ? popMax() : popMin();
     
-    return ret_val;
+    return old_size - tree_size;
 }
 
-template <typename T, typename Comp>
-typename avl<T, Comp>::iterator 
-avl<T, Comp>::end(){
-    return iterator();
-}
 
+/*   ***   Memory layout   ***   */
 
-/*   ***   Tree Traversals   ***   */
-
-template <typename T, typename Comp>
-template <typename Functor>
+template <typename T, typename Comp, typename Stats, typename Balance>
 void 
-avl<T, Comp>::inorder(Functor& func) {
+avl<T, Comp, Stats, Balance>::compact(AVL_LAYOUT layout){
     
-    inorderAux(func, root);
+    if(root == nullptr)
+        return;
+    
+    std::vector<node<T>*> order;
+    order.reserve(tree_size);
+    
+    if(layout == BREADTH_FIRST){
+        
+        order.push_back(root);
+        
+        for(size_t i = 0; i < order.size(); i++){
+            
+            if(order[i]->left)
+                order.push_back(order[i]->left);
+            
+            if(order[i]->right)
+                order.push_back(order[i]->right);
+        }
+    }
+    else{
+        vebOrder(root, countLevels(root), order);
+    }
+    
+    node<T>* block = static_cast<node<T>*>(::operator new(tree_size * sizeof(node<T>)));
+    
+    // The old 'weight' keeps the new index until the sons are linked:
+    for(size_t i = 0; i < tree_size; i++){
+        
+        node<T>* new_node = new (block + i) node<T>();
+        
+        new_node->key = std::move(order[i]->key);
+        new_node->height = order[i]->height;
+        new_node->weight = order[i]->weight;
+        order[i]->weight = i;
+    }
+    
+    for(size_t i = 0; i < tree_size; i++){
+        
+        if(order[i]->left)
+            block[i].left = block + order[i]->left->weight;
+        
+        if(order[i]->right)
+            block[i].right = block + order[i]->right->weight;
+    }
+    
+    min = block + min->weight;
+    max = block + max->weight;
+    root = block;
+    
+    // Node by node, since some of them are in the old block:
+    for(size_t i = 0; i < tree_size; i++){
+        
+        order[i]->left = order[i]->right = nullptr;
+        
+        if(inArena(order[i]))
+            order[i]->~node();
+        else
+            delete order[i];
+    }
+    
+    if(arena != nullptr)
+        ::operator delete(arena->block);
+    else
+        arena = new compact_arena;
+    
+    arena->block = block;
+    arena->size = arena->live = tree_size;
 }
 
 
-template <typename T, typename Comp>
-template <typename Functor>
-void 
-avl<T, Comp>::preorder(Functor& func) {
+/*   ***   Instrumentation   ***   */
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl_stats_snapshot 
+avl<T, Comp, Stats, Balance>::stats() const {
     
-    preorderAux(func, root);
+    avl_stats_snapshot snap;
+    
+    statsPolicy().fill(snap);
+    
+    snap.bytes_per_node = sizeof(node<T>);
+    snap.total_bytes = sizeof(*this) + tree_size * sizeof(node<T>);
+    
+    // the dead slots of the compact() block are not given back until it empties:
+    if(arena != nullptr)
+        snap.total_bytes += sizeof(compact_arena) + (arena->size - arena->live) * sizeof(node<T>);
+    
+    return snap;
 }
 
-
-template <typename T, typename Comp>
-template <typename Functor>
+template <typename T, typename Comp, typename Stats, typename Balance>
 void 
-avl<T, Comp>::postorder(Functor& func) {
+avl<T, Comp, Stats, Balance>::resetStats() {
     
-    postorderAux(func, root);
+    this->avl_ebo<Stats, 0>::get().reset();
 }
 
 
-template <typename T, typename Comp>
-template <typename Functor>
-void 
-avl<T, Comp>::constInorder(Functor& func) const{
+/*   ***   iterator functions   ***   */
 
-    constInorderAux(func, root);
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>::iterator::iterator() 
+        : avl_iterator<T>(nullptr){
 }
 
+template <typename T, typename Comp, typename Stats, typename Balance>
+avl<T, Comp, Stats, Balance>::iterator::iterator(node<T>* root) 
+        : avl_iterator<T>(root){
+}
 
-/*   ************   Implementation of the private methods   ************   */
-
-template <typename T, typename Comp>
-bool 
-avl<T, Comp>::keysEqual(const T& k1, const T& k2) const {
-
-    return (!key_comp(k1, k2)) && (!key_comp(k2, k1));
+template <typename T, typename Comp, typename Stats, typename Balance>
+typename avl<T, Comp, Stats, Balance>::iterator 
+avl<T, Comp, Stats, Balance>::begin() noexcept{
+    
+    iterator ret_val(this->root);
+    
+    ret_val.init_for_begin();
+    
+    return ret_val;
 }
 
-/*   ***   insert & remove Auxiliary Functions   ***   */
+template <typename T, typename Comp, typename Stats, typename Balance>
+typename avl<T, Comp, Stats, Balance>::iterator 
+avl<T, Comp, Stats, Balance>::end(){
+    return iterator();
+}
 
-template <typename T, typename Comp>
-AVL_STATUS
-avl<T, Comp>::insertAux(node<T>* iter, T& element){
 
-    // when we got to a leaf:
-    if(iter == nullptr)
-        return ADD_HERE;
+/*   ***   Hinted insert   ***   */
 
-    if(key_comp(element, iter->key))
-        switch(insertAux(iter->left, element)){
-                
-        case SUCCESS:
-        case WAS_ROLLING:
-            iter->updateWeight();
-            return SUCCESS;
+template <typename T, typename Comp, typename Stats, typename Balance>
+typename avl<T, Comp, Stats, Balance>::iterator 
+avl<T, Comp, Stats, Balance>::insert(iterator hint, T element){
+    
+    if(root == nullptr){
+        
+        insert(element);
+        return begin();
+    }
+    
+    bool at_max = (hint == end()) && less(max->key, element);
+    bool at_min = !at_max && (hint.current == min) && less(element, min->key);
+    
+    if(!at_max && !at_min){
+        
+        insert(element);
+        return find(element);
+    }
+    
+    /*
+     *  Only the root is on both spines. 
+     *  The other spine has to be scanned again only if the root was rolled.
+     */
+    if(insertSpineAux(root, element, at_max) == WAS_ROLLING)
+        updateMinAndMax();
+    else if(at_max)
+        updateMax();
+    else
+        updateMin();
+    
+    tree_size++;
+    
+    if(at_min)
+        return begin();
+    
+    // Nothing is greater than max, so the iterator needs no path
+    iterator ret_val(root);
+    ret_val.current = max;
+    return ret_val;
+}
 
-        case ADD_HERE:
-            iter->left = new node<T>(element);
-            
-        case WAS_HEIGHT_UPDATE:
-            iter->updateWeight();
-            return updateHeight(iter);
 
-        default:
-            return FAILURE;
-        }
+/*   ***   Bulk removal   ***   */
 
-    if(key_comp(iter->key, element))
-        switch(insertAux(iter->right, element)){
+template <typename T, typename Comp, typename Stats, typename Balance>
+size_t 
+avl<T, Comp, Stats, Balance>::erase(iterator first, iterator last){
+    
+    if(first == last)
+        return 0;
+    
+    if(last != end())
+        return erase_range(*first, *last);
+    
+    if constexpr (!Balance::joinable){
+        
+        T from = *first;
+        return erase_if([&](const T& key){ return !less(key, from); });
+    }
+    
+    // [*first, max] is cut off with a single split. 
+    // The key is copied since rotations move keys between nodes:
+    T from = *first;
+    node<T> *left, *found, *right;
+    split(root, from, left, found, right);
+    
+    size_t old_size = tree_size;
+    
+    deleteTree(found);
+    deleteTree(right);
+    resetRoot(left);
+    
+    return old_size - tree_size;
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+size_t 
+avl<T, Comp, Stats, Balance>::erase_range(const T from, const T to){
+    
+    if(root == nullptr || !less(from, to))
+        return 0;
+    
+    if constexpr (!Balance::joinable)
+        return erase_if([&](const T& key){ return !less(key, from) && less(key, to); });
+    
+    node<T> *left, *from_node, *rest;
+    split(root, from, left, from_node, rest);
+    
+    node<T> *mid, *to_node, *right;
+    split(rest, to, mid, to_node, right);
+    
+    // 'to' itself is not in the range:
+    if(to_node != nullptr)
+        right = join(nullptr, to_node, right);
+    
+    size_t old_size = tree_size;
+    
+    deleteTree(from_node);
+    deleteTree(mid);
+    resetRoot(join2(left, right));
+    
+    return old_size - tree_size;
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+template <typename Pred>
+size_t 
+avl<T, Comp, Stats, Balance>::erase_if(Pred pred){
+    
+    PartitionFunctor<T, Pred> functor(pred);
+    constInorderAux(functor, root);
+    
+    size_t num_removed = functor.removed.size();
+    
+    if(num_removed == 0)
+        return 0;
+    
+    /*
+     *  A few keys are removed one by one (O(k*log(n))).
+     *  Otherwise the tree is rebuilt from the kept keys in O(n).
+     */
+    size_t log_n = 1;
+    while((size_t(1) << log_n) < tree_size)
+        log_n++;
+    
+    if(num_removed * log_n < tree_size){
+        
+        for(size_t i = 0; i < num_removed; i++)
+            try_remove(functor.removed[i]);
+    }
+    else{
+        rebuild(functor.kept);
+    }
+    
+    return num_removed;
+}
+
+
+/*   ***   Set algebra   ***   */
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::set_union(const avl& other){
+    
+    avl copy(other);
+    setAlgebra(copy, SET_UNION);
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::set_union(avl&& other){
+    setAlgebra(other, SET_UNION);
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::set_intersection(const avl& other){
+    
+    avl copy(other);
+    setAlgebra(copy, SET_INTERSECTION);
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::set_intersection(avl&& other){
+    setAlgebra(other, SET_INTERSECTION);
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::set_difference(const avl& other){
+    
+    avl copy(other);
+    setAlgebra(copy, SET_DIFFERENCE);
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::set_difference(avl&& other){
+    setAlgebra(other, SET_DIFFERENCE);
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::symmetric_difference(const avl& other){
+    
+    avl copy(other);
+    setAlgebra(copy, SET_SYMMETRIC_DIFFERENCE);
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::symmetric_difference(avl&& other){
+    setAlgebra(other, SET_SYMMETRIC_DIFFERENCE);
+}
+
+
+/*   ***   Non-throwing lookup & update   ***   */
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+std::pair<typename avl<T, Comp, Stats, Balance>::iterator, bool> 
+avl<T, Comp, Stats, Balance>::try_insert(T element){
+    
+    // Ends at the node of the key, new or existing, so there is no second descent:
+    insert_path path;
+    
+    if(root == nullptr){
+        
+        root = newNode(element);
+        min = max = root;
+        path.nodes[path.length++] = root;
+    }
+    else{
+        // insertAux changes nothing on a duplicate, and nothing is thrown:
+        AVL_STATUS status = insertAux(root, element, nullptr, true, &path);
+        
+        if(status == FAILURE)
+            return std::make_pair(pathIterator(path), false);
+        
+        updateMinAndMax(status);
+    }
+
+    tree_size++;
+    
+    return std::make_pair(pathIterator(path), true);
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+bool 
+avl<T, Comp, Stats, Balance>::try_remove(const T& element){
+    
+    node<T>* to_remove = findNode(element);
+    
+    if(to_remove == nullptr)
+        return false;
+    
+    removeNode(to_remove, element);
+    return true;
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+typename avl<T, Comp, Stats, Balance>::iterator 
+avl<T, Comp, Stats, Balance>::find(const T& key) const {
+    
+    iterator ret_val(root);
+    node<T>* iter = root;
+    node<T>* candidate = nullptr;
+    size_t candidate_path = 0;
+    size_t path_length = 0;
+    
+    // Same descent as findNode(). 
+    // Every node where the path turns left is where operator++ continues later
+    while(iter){
+        path_length++;
+        
+        int cmp = three_way_comp ? compare(key, iter->key) : (less(key, iter->key) ? -1 : 1);
+        
+        if(cmp == 0){
+            candidate = iter;
+            candidate_path = ret_val.path.size();
+            break;
+        }
+        
+        if(cmp < 0){
+            ret_val.path.push(iter);
+            iter = iter->left;
+            continue;
+        }
+        
+        if(!three_way_comp){
+            candidate = iter;
+            candidate_path = ret_val.path.size();
+        }
+        
+        iter = iter->right;
+    }
+    statsPolicy().onSearch(path_length);
+    
+    if(candidate == nullptr || (!three_way_comp && less(candidate->key, key)))
+        return iterator();
+    
+    while(ret_val.path.size() > candidate_path)
+        ret_val.path.pop();
+    
+    ret_val.current = candidate;
+    return ret_val;
+}
+
+
+/*   ***   Tree Traversals   ***   */
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+template <typename Functor>
+void 
+avl<T, Comp, Stats, Balance>::inorder(Functor& func) {
+    
+    inorderAux(func, root);
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+template <typename Functor>
+void 
+avl<T, Comp, Stats, Balance>::preorder(Functor& func) {
+    
+    preorderAux(func, root);
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+template <typename Functor>
+void 
+avl<T, Comp, Stats, Balance>::postorder(Functor& func) {
+    
+    postorderAux(func, root);
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+template <typename Functor>
+void 
+avl<T, Comp, Stats, Balance>::constInorder(Functor& func) const{
+
+    constInorderAux(func, root);
+}
+
+
+/*   ***   Early-exit scans   ***   */
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+template <typename Visitor>
+size_t 
+avl<T, Comp, Stats, Balance>::scan(const T& start, Visitor visitor) const{
+    
+    node<T>* stack[scan_stack_size];
+    int top = 0;
+    
+    // The stack keeps the nodes >= 'start' where the path went left, 
+    // which are the next keys in order:
+    for(node<T>* iter = root; iter; ){
+        
+        if(less(iter->key, start)){
+            iter = iter->right;
+            continue;
+        }
+        
+        assert(top < scan_stack_size);
+        stack[top++] = iter;
+        iter = iter->left;
+    }
+    
+    return scanAux(stack, top, visitor);
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+template <typename Visitor>
+size_t 
+avl<T, Comp, Stats, Balance>::scan(Visitor visitor) const{
+    
+    node<T>* stack[scan_stack_size];
+    int top = 0;
+    
+    for(node<T>* iter = root; iter; iter = iter->left){
+        
+        assert(top < scan_stack_size);
+        stack[top++] = iter;
+    }
+    
+    return scanAux(stack, top, visitor);
+}
+
+
+/*   ************   Implementation of the private methods   ************   */
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+bool 
+avl<T, Comp, Stats, Balance>::less(const T& k1, const T& k2) const {
+
+    statsPolicy().onCompare();
+    return avl_comp_traits<T, Comp>::less(keyComp(), k1, k2);
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+int 
+avl<T, Comp, Stats, Balance>::compare(const T& k1, const T& k2) const {
+
+    if(!three_way_comp)
+        return less(k1, k2) ? -1 : (less(k2, k1) ? 1 : 0);
+    
+    statsPolicy().onCompare();
+    return avl_comp_traits<T, Comp>::compare(keyComp(), k1, k2);
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+const Comp& 
+avl<T, Comp, Stats, Balance>::keyComp() const {
+    
+    return this->avl_ebo<Comp, 1>::get();
+}
+
+
+/*   ***   Node allocation   ***   */
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+const Stats& 
+avl<T, Comp, Stats, Balance>::statsPolicy() const {
+    
+    return this->avl_ebo<Stats, 0>::get();
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+node<T>* 
+avl<T, Comp, Stats, Balance>::newNode() {
+    
+    statsPolicy().onAlloc();
+    return new node<T>;
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+node<T>* 
+avl<T, Comp, Stats, Balance>::newNode(const T& key) {
+    
+    statsPolicy().onAlloc();
+    return new node<T>(key);
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::deleteTree(node<T>* iter) {
+    
+    /* node's D'tor frees the whole subtree, which has 'weight' nodes */
+    if(iter != nullptr)
+        statsPolicy().onFree(iter->weight);
+    
+    if(arena == nullptr){
+        
+        delete iter;
+        return;
+    }
+    
+    freeNodes(iter);
+}
+
+/* Like node's D'tor, but a node of the compact() block is only destroyed in place */
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::freeNodes(node<T>* iter) {
+    
+    if(iter == nullptr)
+        return;
+    
+    freeNodes(iter->left);
+    freeNodes(iter->right);
+    
+    iter->left = iter->right = nullptr;
+    
+    if(!inArena(iter)){
+        
+        delete iter;
+        return;
+    }
+    
+    iter->~node();
+    
+    if(--arena->live == 0){
+        
+        ::operator delete(arena->block);
+        delete arena;
+        arena = nullptr;
+    }
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+bool 
+avl<T, Comp, Stats, Balance>::inArena(const node<T>* iter) const {
+    
+    std::less<const node<T>*> before;
+    
+    return arena && !before(iter, arena->block) && before(iter, arena->block + arena->size);
+}
+
+/*   ***   insert & remove Auxiliary Functions   ***   */
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::removeNode(node<T>* to_remove, const T element){
+    
+    if(to_remove->left && to_remove->right){
+        
+        node<T>* following = to_remove->right;
+        
+        while(following->left)
+            following = following->left;
+        
+        T save_following_key = following->key;
+        removeNode(following, save_following_key);
+        
+        node<T>* change_to_following = findNode(element);
+        change_to_following->key = save_following_key;
+        return;
+    }
+
+    if(to_remove->left){
+        
+        std::swap(to_remove->key, to_remove->left->key);
+        std::swap(to_remove->left, to_remove->right);
+    }
+    else if(to_remove->right){
+        
+        std::swap(to_remove->key, to_remove->right->key);
+        std::swap(to_remove->left, to_remove->right);
+    }
+    else if(to_remove == root){
+        
+        min = max = nullptr;
+        tree_size--;
+        node<T>* to_delete = root;
+        root = nullptr;
+        deleteTree(to_delete);
+        return;
+    }
+
+    removeLeaf(root, element);
+    updateMinAndMax();
+        
+    tree_size--;
+}
+
+
+/*
+ *  'candidate' is null on the left spine (the path never turned right), 
+ *  and 'right_spine' is true while the path never turned left.
+ *  A rolling is passed up to the root as WAS_ROLLING only from a spine node,
+ *  since only there it may move the min or the max key (see updateMinAndMax(status)).
+ *  'path', if given, ends at the node of 'element' on return, new or existing.
+ */
+template <typename T, typename Comp, typename Stats, typename Balance>
+AVL_STATUS
+avl<T, Comp, Stats, Balance>::insertAux(node<T>* iter, T& element, node<T>* candidate, bool right_spine,
+                                        insert_path* path){
 
+    // when we got to a leaf. 
+    // With a less-than comparator the only equality check is here (see findNode):
+    if(iter == nullptr){
+        
+        if(!three_way_comp && candidate && !less(candidate->key, element)){
+            
+            // the key is at 'candidate', the last node where the path turned right:
+            if(path)
+                while(path->nodes[path->length - 1] != candidate)
+                    path->length--;
+            
+            return FAILURE;
+        }
+        
+        return ADD_HERE;
+    }
+    
+    if(path)
+        path->nodes[path->length++] = iter;
+    
+    int cmp = three_way_comp ? compare(element, iter->key) : (less(element, iter->key) ? -1 : 1);
+    
+    // if 'element' already exist:
+    if(cmp == 0)
+        return FAILURE;
+
+    if(cmp < 0)
+        switch(insertAux(iter->left, element, candidate, false, path)){
+                
         case SUCCESS:
-        case WAS_ROLLING:
             iter->updateWeight();
             return SUCCESS;
 
+        case WAS_ROLLING:
+            iter->updateWeight();
+            return candidate == nullptr ? WAS_ROLLING : SUCCESS;
+
         case ADD_HERE:
-            iter->right = new node<T>(element);
+            iter->left = newNode(element);
+            
+            if(path)
+                path->nodes[path->length++] = iter->left;
             
         case WAS_HEIGHT_UPDATE:
             iter->updateWeight();
-            return updateHeight(iter);
+            return insertFixPath(iter, element, path);
 
         default:
             return FAILURE;
         }
+
+    switch(insertAux(iter->right, element, iter, right_spine, path)){
+
+    case SUCCESS:
+        iter->updateWeight();
+        return SUCCESS;
+
+    case WAS_ROLLING:
+        iter->updateWeight();
+        return right_spine ? WAS_ROLLING : SUCCESS;
+
+    case ADD_HERE:
+        iter->right = newNode(element);
+        
+        if(path)
+            path->nodes[path->length++] = iter->right;
+        
+    case WAS_HEIGHT_UPDATE:
+        iter->updateWeight();
+        return insertFixPath(iter, element, path);
+
+    default:
+        return FAILURE;
+    }
+}
+
+
+/*
+ *  Balance::insertFix, then mends 'path' if it rolled.
+ *  A rolling at 'iter' relinks 'iter' and at most two path nodes under it, 
+ *  and moves keys among them only. So 'element' is in one of them, or still 
+ *  in the untouched subtree of the path node 3 levels under 'iter'. 
+ *  A descent from 'iter' meets either in 3 steps at most, and the rest of the path stays.
+ */
+template <typename T, typename Comp, typename Stats, typename Balance>
+AVL_STATUS
+avl<T, Comp, Stats, Balance>::insertFixPath(node<T>* iter, const T& element, insert_path* path){
+
+    AVL_STATUS status = Balance::insertFix(iter, statsPolicy());
+
+    if(path == nullptr || status != WAS_ROLLING)
+        return status;
+
+    int top = path->length - 1;
+
+    while(path->nodes[top] != iter)
+        top--;
+
+    int rest = top + 3;
+    node<T>* untouched = rest < path->length ? path->nodes[rest] : nullptr;
+
+    node<T>* relinked[4];
+    int count = 0;
+
+    for(node<T>* walk = iter; ; ){
+
+        int cmp = compare(element, walk->key);
+
+        if(cmp == 0){
+            rest = path->length;
+            break;
+        }
+
+        walk = cmp < 0 ? walk->left : walk->right;
+
+        if(walk == untouched)
+            break;
+
+        assert(count < 4);
+        relinked[count++] = walk;
+    }
+
+    // path = nodes[0, top], relinked, nodes[rest, length):
+    int tail = path->length - rest;
+    int moved_to = top + 1 + count;
+
+    if(moved_to < rest)
+        std::copy(path->nodes + rest, path->nodes + path->length, path->nodes + moved_to);
+    else
+        std::copy_backward(path->nodes + rest, path->nodes + path->length, path->nodes + moved_to + tail);
+
+    std::copy(relinked, relinked + count, path->nodes + top + 1);
+    path->length = moved_to + tail;
+
+    return status;
+}
+
+
+/* An iterator at the last node of 'path'. It keeps the nodes where the path turns left, as find() does */
+template <typename T, typename Comp, typename Stats, typename Balance>
+typename avl<T, Comp, Stats, Balance>::iterator
+avl<T, Comp, Stats, Balance>::pathIterator(const insert_path& path) const{
+
+    iterator ret_val(root);
+
+    for(int i = 0; i + 1 < path.length; i++)
+        if(path.nodes[i]->left == path.nodes[i + 1])
+            ret_val.path.push(path.nodes[i]);
+
+    ret_val.current = path.nodes[path.length - 1];
+
+    return ret_val;
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+AVL_STATUS
+avl<T, Comp, Stats, Balance>::insertSpineAux(node<T>* iter, T& element, bool right_spine){
     
-    // if 'element' already exist:
-    return FAILURE;
+    // 'element' is beyond the spine's end, so no comparison is needed
+    node<T>*& son = right_spine ? iter->right : iter->left;
+    
+    if(son == nullptr){
+        
+        son = newNode(element);
+        iter->updateWeight();
+        return Balance::insertFix(iter, statsPolicy());
+    }
+    
+    switch(insertSpineAux(son, element, right_spine)){
+            
+    case SUCCESS:
+    case WAS_ROLLING:
+        iter->updateWeight();
+        return SUCCESS;
+        
+    default:
+        iter->updateWeight();
+        return Balance::insertFix(iter, statsPolicy());
+    }
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 AVL_STATUS
-avl<T, Comp>::removeLeaf(node<T>* iter, T leaf){
+avl<T, Comp, Stats, Balance>::removeLeaf(node<T>* iter, T leaf){
     
     node<T>* to_delete = nullptr;
     
-    if(key_comp(leaf, iter->key))
+    // 'leaf' is in the tree and its node is a leaf. 
+    // Every other node on its path has sons, so no equality check is needed:
+    if(iter->left == nullptr && iter->right == nullptr)
+        return REMOVE_HERE;
+    
+    if(less(leaf, iter->key))
         switch(removeLeaf(iter->left, leaf)){
                 
         case REMOVE_HERE:
             to_delete = iter->left;
             iter->left = nullptr;
-            delete to_delete;
+            deleteTree(to_delete);
 
         case WAS_HEIGHT_UPDATE:
         case WAS_ROLLING:
             iter->updateWeight();
-            return updateHeight(iter);
+            return Balance::removeFix(iter, statsPolicy());
 
         default:
             iter->updateWeight();
             return SUCCESS;
         }
     
-    if(key_comp(iter->key, leaf))
-        switch(removeLeaf(iter->right, leaf)){
-                
-        case REMOVE_HERE:
-            to_delete = iter->right;
-            iter->right = nullptr;
-            delete to_delete;
-            
-        case WAS_HEIGHT_UPDATE:
-        case WAS_ROLLING:
-            iter->updateWeight();
-            return updateHeight(iter);
+    switch(removeLeaf(iter->right, leaf)){
+            
+    case REMOVE_HERE:
+        to_delete = iter->right;
+        iter->right = nullptr;
+        deleteTree(to_delete);
+        
+    case WAS_HEIGHT_UPDATE:
+    case WAS_ROLLING:
+        iter->updateWeight();
+        return Balance::removeFix(iter, statsPolicy());
+
+    default:
+        iter->updateWeight();
+        return SUCCESS;
+    }
+}
+
+
+/*
+ *  Removes the end of the left (or right) spine and returns its key.
+ *  min & max are not updated. 
+ *  The end node has no son on the spine side, so its other son takes its place.
+ */
+template <typename T, typename Comp, typename Stats, typename Balance>
+T 
+avl<T, Comp, Stats, Balance>::popSpine(bool right_spine){
+    
+    T popped;
+    node<T>* son = right_spine ? root->right : root->left;
+    
+    if(son == nullptr){
+        
+        node<T>* to_delete = root;
+        popped = to_delete->key;
+        root = right_spine ? to_delete->left : to_delete->right;
+        
+        to_delete->left = to_delete->right = nullptr;
+        deleteTree(to_delete);
+    }
+    else{
+        popSpineAux(root, popped, right_spine);
+    }
+    
+    tree_size--;
+    return popped;
+}
 
-        default:
-            iter->updateWeight();
-            return SUCCESS;
-        }
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+AVL_STATUS
+avl<T, Comp, Stats, Balance>::popSpineAux(node<T>* iter, T& popped, bool right_spine){
+    
+    node<T>*& son = right_spine ? iter->right : iter->left;
+    AVL_STATUS status = REMOVE_HERE;
     
-    return REMOVE_HERE;
+    if(right_spine ? son->right : son->left){
+        
+        status = popSpineAux(son, popped, right_spine);
+    }
+    else{
+        node<T>* to_delete = son;
+        popped = to_delete->key;
+        son = right_spine ? to_delete->left : to_delete->right;
+        
+        to_delete->left = to_delete->right = nullptr;
+        deleteTree(to_delete);
+    }
+    
+    iter->updateWeight();
+    
+    if(status == SUCCESS)
+        return SUCCESS;
+    
+    return Balance::removeFix(iter, statsPolicy());
 }
 
 
 /*   ***   select & contains Auxiliary Functions   ***   */
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 const T& 
-avl<T, Comp>::selectAux(node<T>* iter, size_t index) const {
+avl<T, Comp, Stats, Balance>::selectAux(node<T>* iter, size_t index) const {
     
     if(iter->w_left() > index - 1){
         
@@ -510,141 +1442,563 @@ avl<T, Comp>::selectAux(node<T>* iter, size_t index) const {
 }
 
 
-template <typename T, typename Comp>
-node<T>* 
-avl<T, Comp>::find(const T& key) const {
+/*
+ *  Answers the indices [first, last) which are all in the subtree of 'iter'.
+ *  'offset' is the number of keys before the subtree.
+ *  The answer of *p is written to out[p - indices].
+ *  Every subtree is visited once for the whole batch: O(k*log(n/k)).
+ */
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::selectManyAux(node<T>* iter, const size_t* first, const size_t* last,
+                                   size_t offset, T* out, const size_t* indices) const {
+    
+    size_t position = offset + iter->w_left() + 1;
+    
+    const size_t* mid_first = std::lower_bound(first, last, position);
+    const size_t* mid_last = std::upper_bound(mid_first, last, position);
+    
+    if(first != mid_first)
+        selectManyAux(iter->left, first, mid_first, offset, out, indices);
+    
+    for(const size_t* p = mid_first; p != mid_last; p++)
+        out[p - indices] = iter->key;
     
+    if(mid_last != last)
+        selectManyAux(iter->right, mid_last, last, position, out, indices);
+}
+
+
+/* Same scheme as selectManyAux, over sorted keys. out[p - keys] is the rank of *p */
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::rankManyAux(node<T>* iter, const T* first, const T* last,
+                                 size_t offset, size_t* out, const T* keys) const {
+    
+    if(iter == nullptr)
+        throw key_not_exist<T>(*first);
+    
+    // Binary search for the keys less than iter->key, then the keys equal to it:
+    const T* mid_first = std::partition_point(first, last, 
+            [this, iter](const T& key){ return less(key, iter->key); });
+    
+    const T* mid_last = std::partition_point(mid_first, last, 
+            [this, iter](const T& key){ return !less(iter->key, key); });
+    
+    if(first != mid_first)
+        rankManyAux(iter->left, first, mid_first, offset, out, keys);
+    
+    size_t position = offset + iter->w_left() + 1;
+    
+    for(const T* p = mid_first; p != mid_last; p++)
+        out[p - keys] = position;
+    
+    if(mid_last != last)
+        rankManyAux(iter->right, mid_last, last, position, out, keys);
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+node<T>* 
+avl<T, Comp, Stats, Balance>::findNode(const T& key) const {
+    
+    /*
+     *  One comparison per level. 
+     *  A three-way comparator stops at the key. With a less-than comparator 
+     *  the path goes down to a leaf, and equality is checked once at the end,
+     *  against the last node where the path turned right.
+     */
     node<T>* iter = root;
+    node<T>* candidate = nullptr;
+    size_t path_length = 0;
     
     while(iter){
-        if(keysEqual(key, iter->key))
-            return iter;
+        path_length++;
         
-        if(key_comp(key, iter->key))
+        int cmp = three_way_comp ? compare(key, iter->key) : (less(key, iter->key) ? -1 : 1);
+        
+        if(cmp == 0){
+            candidate = iter;
+            break;
+        }
+        
+        if(cmp < 0){
             iter = iter->left;
-        else
-            iter = iter->right;
+            continue;
+        }
+        
+        if(!three_way_comp)
+            candidate = iter;
+        
+        iter = iter->right;
     }
-    return nullptr;
+    statsPolicy().onSearch(path_length);
+    
+    if(candidate == nullptr || (!three_way_comp && less(candidate->key, key)))
+        return nullptr;
+    
+    return candidate;
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::updateMinAndMax(){
+
+    updateMin();
+    updateMax();
 }
 
+/*
+ *  After insertAux added a key to a non-empty tree. 
+ *  Unless a spine rolled, the nodes kept their keys, and a new min (max) 
+ *  can only be the new left (right) son of the old one. So no scan & no comparison.
+ */
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::updateMinAndMax(AVL_STATUS insert_status){
+
+    if(insert_status == WAS_ROLLING)
+        updateMinAndMax();
+    else if(min->left)
+        min = min->left;
+    else if(max->right)
+        max = max->right;
+}
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 void 
-avl<T, Comp>::updateMinAndMax(){
+avl<T, Comp, Stats, Balance>::updateMin(){
 
     node<T>* iter = root;
 
     if(!iter){
-        min = max = nullptr;
+        min = nullptr;
         return;
     }
 
     while(iter->left)
         iter = iter->left;
     min = iter;
+}
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::updateMax(){
+
+    node<T>* iter = root;
+
+    if(!iter){
+        max = nullptr;
+        return;
+    }
 
-    iter = root;
     while(iter->right)
         iter = iter->right;
     max = iter;
 }
 
 
-/*   ***   Height balance of AVL   ***   */
+/*   ***   Split & join   ***   */
 
-template <typename T, typename Comp>
-AVL_STATUS
-avl<T, Comp>::updateHeight(node<T>* iter){
+/* These use 'height' as the real height, so they serve a joinable Balance only */
+
+/*
+ *  'mid' is a single node that is greater than every key of 'left' 
+ *  and less than every key of 'right'. Returns the root of the joined tree.
+ *  O(|height(left) - height(right)|).
+ */
+template <typename T, typename Comp, typename Stats, typename Balance>
+node<T>* 
+avl<T, Comp, Stats, Balance>::join(node<T>* left, node<T>* mid, node<T>* right){
     
-    int old_height = iter->height;
-    int balance_f = balanceFactor(iter);
+    int left_height = left ? left->height : -1;
+    int right_height = right ? right->height : -1;
     
-    if(balance_f == 2){
-        switch(balanceFactor(iter->left)){
-                
-        case -1:    // LR-rolling. which is RR(left son) + LL
-            genericRollingPart(iter->left);
-            swapSons(iter->left->right);
-            swapSons(iter->left);
-                
-        default:    // LL-rolling
-            swapSons(iter);
-            swapSons(iter->right);
-            genericRollingPart(iter);
+    if(left_height > right_height + 1){
+        
+        left->right = join(left->right, mid, right);
+        left->updateWeight();
+        Balance::insertFix(left, statsPolicy());
+        return left;
+    }
+    
+    if(right_height > left_height + 1){
+        
+        right->left = join(left, mid, right->left);
+        right->updateWeight();
+        Balance::insertFix(right, statsPolicy());
+        return right;
+    }
+    
+    mid->left = left;
+    mid->right = right;
+    mid->height = 1 + maxHeight<T>(left, right);
+    mid->updateWeight();
+    return mid;
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+node<T>* 
+avl<T, Comp, Stats, Balance>::join2(node<T>* left, node<T>* right){
+    
+    if(right == nullptr)
+        return left;
+    
+    node<T>* mid = extractMin(right);
+    
+    return join(left, mid, right);
+}
+
+
+/*
+ *  Splits the subtree of 'iter' into the keys less than 'key' (left),
+ *  the node of 'key' if it exists (found), and the keys greater than 'key' (right).
+ *  O(log(n)).
+ */
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::split(node<T>* iter, const T& key, 
+                           node<T>*& left, node<T>*& found, node<T>*& right){
+    
+    if(iter == nullptr){
+        
+        left = found = right = nullptr;
+        return;
+    }
+    
+    node<T>* sub_left = iter->left;
+    node<T>* sub_right = iter->right;
+    
+    iter->left = iter->right = nullptr;
+    iter->height = 0;
+    iter->weight = 1;
+    
+    int cmp = compare(key, iter->key);
+    
+    if(cmp < 0){
+        
+        node<T>* mid_right;
+        split(sub_left, key, left, found, mid_right);
+        right = join(mid_right, iter, sub_right);
+    }
+    else if(cmp > 0){
+        
+        node<T>* mid_left;
+        split(sub_right, key, mid_left, found, right);
+        left = join(sub_left, iter, mid_left);
+    }
+    else{
+        left = sub_left;
+        found = iter;
+        right = sub_right;
+    }
+}
+
+
+/* Detaches the minimum node of the subtree. 'iter' is updated to the new subtree root */
+template <typename T, typename Comp, typename Stats, typename Balance>
+node<T>* 
+avl<T, Comp, Stats, Balance>::extractMin(node<T>*& iter){
+    
+    if(iter->left == nullptr){
+        
+        node<T>* min_node = iter;
+        iter = iter->right;
+        
+        min_node->right = nullptr;
+        min_node->height = 0;
+        min_node->weight = 1;
+        return min_node;
+    }
+    
+    node<T>* min_node = extractMin(iter->left);
+    
+    iter->updateWeight();
+    Balance::removeFix(iter, statsPolicy());
+    
+    return min_node;
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::resetRoot(node<T>* new_root){
+    
+    root = new_root;
+    tree_size = root ? root->weight : 0;
+    updateMinAndMax();
+}
+
+
+/*   ***   Set algebra Auxiliary Functions   ***   */
+
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::setAlgebra(avl& other, AVL_SET_OP op){
+    
+    // a.set_union(std::move(a)):
+    if(&other == this){
+        
+        if(op == SET_DIFFERENCE || op == SET_SYMMETRIC_DIFFERENCE){
+            
+            node<T>* to_delete = root;
+            resetRoot(nullptr);
+            deleteTree(to_delete);
         }
+        
+        return;
     }
     
-    if(balance_f == -2){
-        switch(balanceFactor(iter->right)){
-                
-        case 1:     // RL-rolling. which is LL(right son) + RR
-            swapSons(iter->right);
-            swapSons(iter->right->right);
-            genericRollingPart(iter->right);
-                
-        default:    // RR-rolling
-            genericRollingPart(iter);
-            swapSons(iter->right);
-            swapSons(iter);
+    // The nodes of the compact() block of 'other' must be freed by 'other':
+    if(other.arena != nullptr){
+        
+        avl copy(other);
+        
+        node<T>* to_delete = other.root;
+        other.resetRoot(nullptr);
+        other.deleteTree(to_delete);
+        
+        setAlgebra(copy, op);
+        return;
+    }
+    
+    if constexpr (!Balance::joinable){
+        
+        mergeAlgebra(other, op);
+    }
+    else{
+        int forks = 0;
+        
+        if(std::is_same<Stats, avl_no_stats>::value){
+            
+            for(unsigned threads = std::thread::hardware_concurrency(); threads > 1; threads /= 2)
+                forks++;
         }
+        
+        std::vector<node<T>*> dropped;
+        node<T>* result = setAlgebraAux(root, other.root, op, dropped, forks);
+        
+        // The nodes are in 'result' or in 'dropped' now:
+        other.resetRoot(nullptr);
+        root = nullptr;
+        
+        for(node<T>* iter : dropped)
+            deleteTree(iter);
+        
+        resetRoot(result);
+    }
+    
+    node<T>* to_delete = other.root;
+    other.resetRoot(nullptr);
+    other.deleteTree(to_delete);
+}
+
+
+/*
+ *  The root of one tree splits the other one, the two halves are solved 
+ *  recursively (in parallel while 'forks' is positive), and the root joins them back.
+ *  The difference splits iter1 by the root of iter2, the other operations split iter2.
+ *  A node that leaves the result goes to 'dropped', whole subtrees included,
+ *  so the parallel calls never free memory.
+ */
+template <typename T, typename Comp, typename Stats, typename Balance>
+node<T>* 
+avl<T, Comp, Stats, Balance>::setAlgebraAux(node<T>* iter1, node<T>* iter2, AVL_SET_OP op,
+                                   std::vector<node<T>*>& dropped, int forks){
+    
+    if(iter1 == nullptr || iter2 == nullptr){
+        
+        node<T>* only = iter1 ? iter1 : iter2;
+        node<T>* kept = only;
+        
+        if(op == SET_INTERSECTION)
+            kept = nullptr;
+        
+        if(op == SET_DIFFERENCE)
+            kept = iter1;
+        
+        if(only != kept)
+            dropped.push_back(only);
+        
+        return kept;
+    }
+    
+    bool split_first = (op == SET_DIFFERENCE);
+    node<T>* pivot = split_first ? iter2 : iter1;
+    node<T>* pivot_left = pivot->left;
+    node<T>* pivot_right = pivot->right;
+    
+    bool parallel = forks > 0 && iter1->weight + iter2->weight >= parallel_grain;
+    
+    pivot->left = pivot->right = nullptr;
+    pivot->height = 0;
+    pivot->weight = 1;
+    
+    node<T> *split_left, *found, *split_right;
+    split(split_first ? iter1 : iter2, pivot->key, split_left, found, split_right);
+    
+    node<T>* left1 = split_first ? split_left : pivot_left;
+    node<T>* left2 = split_first ? pivot_left : split_left;
+    node<T>* right1 = split_first ? split_right : pivot_right;
+    node<T>* right2 = split_first ? pivot_right : split_right;
+    
+    node<T> *left, *right;
+    
+    if(parallel){
+        
+        std::vector<node<T>*> left_dropped;
+        std::future<node<T>*> left_result = std::async(std::launch::async, [&]{
+            return setAlgebraAux(left1, left2, op, left_dropped, forks - 1);
+        });
+        
+        right = setAlgebraAux(right1, right2, op, dropped, forks - 1);
+        left = left_result.get();
+        
+        dropped.insert(dropped.end(), left_dropped.begin(), left_dropped.end());
+    }
+    else{
+        left = setAlgebraAux(left1, left2, op, dropped, 0);
+        right = setAlgebraAux(right1, right2, op, dropped, 0);
     }
     
-    iter->height = 1 + maxHeight<T>(iter->left, iter->right);
+    bool in_both = (found != nullptr);
+    bool keep_pivot = (op == SET_UNION) || (op == SET_INTERSECTION && in_both) 
+                      || (op == SET_SYMMETRIC_DIFFERENCE && !in_both);
     
-    if(std::abs(balance_f) > 1)
-        return WAS_ROLLING;
+    // the pivot's key stands for both trees, so an equal key of the split tree always goes:
+    if(found != nullptr)
+        dropped.push_back(found);
     
-    if(iter->height != old_height)
-        return WAS_HEIGHT_UPDATE;
+    if(keep_pivot)
+        return join(left, pivot, right);
     
-    return SUCCESS;
+    dropped.push_back(pivot);
+    return join2(left, right);
 }
 
 
-template <typename T, typename Comp>
-int 
-avl<T, Comp>::balanceFactor(node<T>* iter){
-    
-    int left_height = 0, right_height = 0;
+/* O(n + m) by the sorted keys, for a Balance that can't join */
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::mergeAlgebra(const avl& other, AVL_SET_OP op){
     
-    if(iter->left)
-        left_height = iter->left->height + 1;
+    std::vector<T> keys1 = getAll(), keys2 = other.getAll(), result;
+    avl_less_than<T, Comp> by_comp(keyComp());
+    auto out = std::back_inserter(result);
     
-    if(iter->right)
-        right_height = iter->right->height + 1;
+    switch(op){
+        
+    case SET_UNION:
+        std::set_union(keys1.begin(), keys1.end(), keys2.begin(), keys2.end(), out, by_comp);
+        break;
+        
+    case SET_INTERSECTION:
+        std::set_intersection(keys1.begin(), keys1.end(), keys2.begin(), keys2.end(), out, by_comp);
+        break;
+        
+    case SET_DIFFERENCE:
+        std::set_difference(keys1.begin(), keys1.end(), keys2.begin(), keys2.end(), out, by_comp);
+        break;
+        
+    case SET_SYMMETRIC_DIFFERENCE:
+        std::set_symmetric_difference(keys1.begin(), keys1.end(), keys2.begin(), keys2.end(), out, by_comp);
+        break;
+    }
     
-    return left_height - right_height;
+    rebuild(result);
 }
 
 
-template <typename T, typename Comp>
+/*   ***   compact Auxiliary Functions   ***   */
+
+/*
+ *  Van Emde Boas order of the top 'levels' levels of the subtree:
+ *  the top half of the levels first, then each subtree below it, left to right,
+ *  each laid out the same way. A search path crosses O(log(n) / log(B)) blocks 
+ *  of B nodes, for any cache line or page size B.
+ */
+template <typename T, typename Comp, typename Stats, typename Balance>
 void 
-avl<T, Comp>::genericRollingPart(node<T>* B){
+avl<T, Comp, Stats, Balance>::vebOrder(node<T>* iter, int levels, std::vector<node<T>*>& order){
+    
+    if(iter == nullptr)
+        return;
     
-    std::swap(B->key, B->right->key);
-    std::swap(B->left, B->right->right);
+    if(levels == 1){
+        
+        order.push_back(iter);
+        return;
+    }
+    
+    int top_levels = levels / 2;
     
-    B->right->height = 1 + maxHeight<T>(B->right->left, B->right->right);
-    B->height = 1 + maxHeight<T>(B->left, B->right);
+    vebOrder(iter, top_levels, order);
     
-    B->right->updateWeight();
-    B->updateWeight();
+    std::vector<node<T>*> bottoms;
+    collectAtDepth(iter, top_levels, bottoms);
+    
+    for(node<T>* bottom : bottoms)
+        vebOrder(bottom, levels - top_levels, order);
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 void 
-avl<T, Comp>::swapSons(node<T>* father){
-    std::swap(father->left, father->right);
+avl<T, Comp, Stats, Balance>::collectAtDepth(node<T>* iter, int depth, std::vector<node<T>*>& out){
+    
+    if(iter == nullptr)
+        return;
+    
+    if(depth == 0){
+        
+        out.push_back(iter);
+        return;
+    }
+    
+    collectAtDepth(iter->left, depth - 1, out);
+    collectAtDepth(iter->right, depth - 1, out);
+}
+
+
+/* 'height' is a rank with some Balance policies, so the levels are counted */
+template <typename T, typename Comp, typename Stats, typename Balance>
+int 
+avl<T, Comp, Stats, Balance>::countLevels(node<T>* iter) const {
+    
+    if(iter == nullptr)
+        return 0;
+    
+    return 1 + std::max(countLevels(iter->left), countLevels(iter->right));
 }
 
 
 /*   ***   Build almost-complete tree   ***   */
 
-template <typename T, typename Comp>
+/* Replaces the tree by the keys of 'sorted_elem' (sorted & unique) in O(size) */
+template <typename T, typename Comp, typename Stats, typename Balance>
+void 
+avl<T, Comp, Stats, Balance>::rebuild(std::vector<T>& sorted_elem){
+    
+    min = max = nullptr;
+    node<T>* to_delete = root;
+    root = nullptr;
+    deleteTree(to_delete);
+    
+    buildAlmostCompleteTree(sorted_elem.size());
+
+    SetFunctor<T, Comp, vec_iter> functor(sorted_elem.begin(), sorted_elem.end(), keyComp());
+    inorderAux<SetFunctor<T, Comp, vec_iter>>(functor, root);
+
+    updateMinAndMax();
+    tree_size = sorted_elem.size();
+}
+
+
+template <typename T, typename Comp, typename Stats, typename Balance>
 void 
-avl<T, Comp>::buildAlmostCompleteTree(size_t size){
+avl<T, Comp, Stats, Balance>::buildAlmostCompleteTree(size_t size){
     
     assert(this->root == nullptr);
     
@@ -664,14 +2018,14 @@ avl<T, Comp>::buildAlmostCompleteTree(size_t size){
     initHeightAndWeight(this->root);
 }
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 node<T>* 
-avl<T, Comp>::buildCompleteTree(int height){
+avl<T, Comp, Stats, Balance>::buildCompleteTree(int height){
     
     if(height == -1)
         return nullptr;
     
-    node<T>* _root = new node<T>;
+    node<T>* _root = newNode();
     
     _root->left = buildCompleteTree(height - 1);
     _root->right = buildCompleteTree(height - 1);
@@ -679,9 +2033,9 @@ avl<T, Comp>::buildCompleteTree(int height){
     return _root;
 }
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 void 
-avl<T, Comp>::removeLeaves(node<T>** it_ptr, int& num_to_remove, int root_height){
+avl<T, Comp, Stats, Balance>::removeLeaves(node<T>** it_ptr, int& num_to_remove, int root_height){
     
     if(num_to_remove == 0)
         return;
@@ -690,7 +2044,7 @@ avl<T, Comp>::removeLeaves(node<T>** it_ptr, int& num_to_remove, int root_height
         
         node<T>* temp = *it_ptr;
         *it_ptr = nullptr;
-        delete temp;
+        deleteTree(temp);
         num_to_remove--;
         return;
     }
@@ -699,9 +2053,9 @@ avl<T, Comp>::removeLeaves(node<T>** it_ptr, int& num_to_remove, int root_height
     removeLeaves(&((*it_ptr)->left), num_to_remove, root_height - 1);
 }
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 void 
-avl<T, Comp>::initHeightAndWeight(node<T>* iter){
+avl<T, Comp, Stats, Balance>::initHeightAndWeight(node<T>* iter){
     
     if(iter == nullptr)
         return;
@@ -709,17 +2063,46 @@ avl<T, Comp>::initHeightAndWeight(node<T>* iter){
     initHeightAndWeight(iter->left);
     initHeightAndWeight(iter->right);
     
-    iter->height = 1 + maxHeight<T>(iter->left, iter->right);
+    Balance::initRank(iter);
     iter->updateWeight();
 }
 
 
+/*   ***   scan Auxiliary   ***   */
+
+/* Pops the next key, visits it, then pushes the left spine of its right son */
+template <typename T, typename Comp, typename Stats, typename Balance>
+template <typename Visitor>
+size_t 
+avl<T, Comp, Stats, Balance>::scanAux(node<T>** stack, int top, Visitor& visitor) const{
+    
+    size_t visited = 0;
+    
+    while(top > 0){
+        
+        node<T>* current = stack[--top];
+        visited++;
+        
+        if(visitor(static_cast<const T&>(current->key)) == VISIT_STOP)
+            break;
+        
+        for(node<T>* iter = current->right; iter; iter = iter->left){
+            
+            assert(top < scan_stack_size);
+            stack[top++] = iter;
+        }
+    }
+    
+    return visited;
+}
+
+
 /*   ***   Tree Traversals Auxiliary   ***   */
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 template <typename Functor>
 void 
-avl<T, Comp>::inorderAux(Functor& func, node<T>* iter) {
+avl<T, Comp, Stats, Balance>::inorderAux(Functor& func, node<T>* iter) {
     
     if(iter == nullptr)
         return;
@@ -732,10 +2115,10 @@ avl<T, Comp>::inorderAux(Functor& func, node<T>* iter) {
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 template <typename Functor>
 void 
-avl<T, Comp>::preorderAux(Functor& func, node<T>* iter) {
+avl<T, Comp, Stats, Balance>::preorderAux(Functor& func, node<T>* iter) {
     
     if(iter == nullptr)
         return;
@@ -747,10 +2130,10 @@ avl<T, Comp>::preorderAux(Functor& func, node<T>* iter) {
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 template <typename Functor>
 void 
-avl<T, Comp>::postorderAux(Functor& func, node<T>* iter) {
+avl<T, Comp, Stats, Balance>::postorderAux(Functor& func, node<T>* iter) {
     
     if(iter == nullptr)
         return;
@@ -762,10 +2145,10 @@ avl<T, Comp>::postorderAux(Functor& func, node<T>* iter) {
 }
 
 
-template <typename T, typename Comp>
+template <typename T, typename Comp, typename Stats, typename Balance>
 template <typename Functor>
 void 
-avl<T, Comp>::constInorderAux(Functor& func, node<T>* iter) const {
+avl<T, Comp, Stats, Balance>::constInorderAux(Functor& func, node<T>* iter) const {
 
     if(iter == nullptr)
         return;
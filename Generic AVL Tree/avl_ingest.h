@@ -0,0 +1,438 @@
+#ifndef AVL_INGEST_H_
+#define AVL_INGEST_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "avl_impl.h"
+
+
+/*   ***   Counters returned by avl_ingest::metrics()   ***   */
+
+struct avl_ingest_metrics {
+    size_t queue_depth = 0;     // pushed and not applied yet
+    size_t pushed = 0;
+    size_t applied = 0;
+    size_t collapsed = 0;       // ops dropped since a later op on the same key won
+    size_t batches = 0;
+    size_t last_batch = 0;
+    size_t max_batch = 0;
+};
+
+
+/*
+ *  Write front end of an avl for many producer threads.
+ *
+ *  insert() and remove() only push the op into a lock-free multi-producer queue.
+ *  One applier thread drains it in batches of up to 'max_batch' ops:
+ *  a batch is sorted by key, only the last op on each key is kept,
+ *  and the result is applied under the write lock, one by one if the batch is small,
+ *  or as one sorted merge and an O(n) rebuild if it is big.
+ *
+ *  The ops are applied like try_insert & try_remove: an existing key or a missing one is no error.
+ *  read() gives the tree to a functor under a read lock.
+ *  flush() waits until every op pushed before it is in the tree (read-your-writes).
+ */
+
+template <typename T, typename Comp = std::less<T>>
+class avl_ingest {
+    using tree_type = avl<T, Comp>;
+
+    struct op {
+        T key;
+        bool insert;
+    };
+
+    /* Node of the queue (D. Vyukov's intrusive MPSC queue) */
+    struct op_node {
+        std::atomic<op_node*> next;
+        op value;
+    };
+
+    tree_type tree;
+    mutable std::shared_mutex tree_lock;
+    Comp comp;
+    size_t max_batch;
+
+// Queue. Producers swap 'head', only the applier touches 'tail':
+    op_node stub;
+    std::atomic<op_node*> head;
+    op_node* tail;
+
+// Counters:
+    std::atomic<size_t> pushed;
+    std::atomic<size_t> dequeued;
+    std::atomic<size_t> applied;
+    std::atomic<size_t> collapsed;
+    std::atomic<size_t> batches;
+    std::atomic<size_t> last_batch;
+    std::atomic<size_t> biggest_batch;
+
+// Applier thread:
+    std::mutex wake_lock;
+    std::condition_variable wake;       // work for the applier
+    std::condition_variable done;       // a batch was applied (for flush)
+    std::atomic<bool> idle;
+    std::atomic<bool> stop;
+    std::thread applier;
+
+public:
+// Constractors:
+    explicit avl_ingest(size_t max_batch = 4096, const Comp& comp = Comp());
+    avl_ingest(const avl_ingest&) = delete;
+    avl_ingest& operator=(const avl_ingest&) = delete;
+
+    /* Applies what is still queued, then stops the applier */
+    ~avl_ingest();
+
+// Producers:
+    void insert(const T& key);
+    void remove(const T& key);
+
+// Readers:
+    void flush();
+
+    /* Calls func(const avl<T, Comp>&) under the read lock and returns its result */
+    template <typename Func>
+    auto read(Func func) const;
+
+    avl_ingest_metrics metrics() const;
+
+private:
+    void push(const T& key, bool insert);
+    void enqueue(op_node* node);
+    op_node* dequeue();
+
+    void applierLoop();
+    size_t drain(std::vector<op>& batch);
+    void apply(std::vector<op>& batch);
+    void mergeApply(const std::vector<op>& batch);
+
+    bool less(const T& k1, const T& k2) const;
+};
+
+
+/*   ***   Constructors   ***   */
+
+template <typename T, typename Comp>
+avl_ingest<T, Comp>::avl_ingest(size_t max_batch, const Comp& comp)
+        : tree(comp), comp(comp), max_batch(max_batch ? max_batch : 1), head(&stub), tail(&stub),
+          pushed(0), dequeued(0), applied(0), collapsed(0),
+          batches(0), last_batch(0), biggest_batch(0),
+          idle(false), stop(false){
+
+    stub.next.store(nullptr);
+
+    // Every member is ready, so the thread is started last:
+    applier = std::thread(&avl_ingest::applierLoop, this);
+}
+
+
+template <typename T, typename Comp>
+avl_ingest<T, Comp>::~avl_ingest(){
+    {
+        std::lock_guard<std::mutex> guard(wake_lock);
+        stop = true;
+    }
+    wake.notify_one();
+    applier.join();
+}
+
+
+/*   ***   Producers   ***   */
+
+template <typename T, typename Comp>
+void
+avl_ingest<T, Comp>::insert(const T& key){
+    push(key, true);
+}
+
+template <typename T, typename Comp>
+void
+avl_ingest<T, Comp>::remove(const T& key){
+    push(key, false);
+}
+
+
+/*   ***   Readers   ***   */
+
+/*
+ *  The op count is taken before the op is queued, so every op queued before
+ *  the caller's ops is already counted in 'target'. The queue is FIFO, so once
+ *  'target' ops were applied, the caller's ops were too.
+ */
+template <typename T, typename Comp>
+void
+avl_ingest<T, Comp>::flush(){
+
+    size_t target = pushed.load();
+
+    std::unique_lock<std::mutex> lock(wake_lock);
+    wake.notify_one();
+    done.wait(lock, [&]{ return applied.load() >= target; });
+}
+
+
+template <typename T, typename Comp>
+template <typename Func>
+auto
+avl_ingest<T, Comp>::read(Func func) const{
+
+    std::shared_lock<std::shared_mutex> guard(tree_lock);
+    return func(static_cast<const tree_type&>(tree));
+}
+
+
+template <typename T, typename Comp>
+avl_ingest_metrics
+avl_ingest<T, Comp>::metrics() const{
+
+    avl_ingest_metrics snap;
+
+    snap.pushed = pushed.load();
+    snap.applied = applied.load();
+    snap.queue_depth = snap.pushed - dequeued.load();
+    snap.collapsed = collapsed.load();
+    snap.batches = batches.load();
+    snap.last_batch = last_batch.load();
+    snap.max_batch = biggest_batch.load();
+
+    return snap;
+}
+
+
+/*   ***   Queue   ***   */
+
+template <typename T, typename Comp>
+void
+avl_ingest<T, Comp>::push(const T& key, bool insert){
+
+    op_node* node = new op_node;
+    node->value.key = key;
+    node->value.insert = insert;
+
+    // Counted before it's queued (see flush):
+    pushed++;
+    enqueue(node);
+
+    if(idle.load()){
+
+        std::lock_guard<std::mutex> guard(wake_lock);
+        wake.notify_one();
+    }
+}
+
+
+/* Wait-free: one exchange, then the link from the former head */
+template <typename T, typename Comp>
+void
+avl_ingest<T, Comp>::enqueue(op_node* node){
+
+    node->next.store(nullptr, std::memory_order_relaxed);
+
+    op_node* prev = head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+}
+
+
+/* Applier only. nullptr if the queue is empty, or the next node is not linked yet */
+template <typename T, typename Comp>
+typename avl_ingest<T, Comp>::op_node*
+avl_ingest<T, Comp>::dequeue(){
+
+    op_node* first = tail;
+    op_node* next = first->next.load(std::memory_order_acquire);
+
+    if(first == &stub){
+
+        if(next == nullptr)
+            return nullptr;
+
+        tail = next;
+        first = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if(next){
+
+        tail = next;
+        return first;
+    }
+
+    if(first != head.load(std::memory_order_acquire))
+        return nullptr;
+
+    // 'first' is the last node. The stub goes behind it, so it can be taken:
+    enqueue(&stub);
+    next = first->next.load(std::memory_order_acquire);
+
+    if(next){
+
+        tail = next;
+        return first;
+    }
+
+    return nullptr;
+}
+
+
+/*   ***   Applier   ***   */
+
+template <typename T, typename Comp>
+void
+avl_ingest<T, Comp>::applierLoop(){
+
+    std::vector<op> batch;
+
+    while(true){
+
+        if(drain(batch) > 0){
+
+            apply(batch);
+            continue;
+        }
+
+        // A producer counted its op but didn't link it yet:
+        if(pushed.load() != dequeued.load()){
+
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_lock);
+
+        if(stop)
+            return;
+
+        idle = true;
+        wake.wait(lock, [&]{ return stop || pushed.load() != dequeued.load(); });
+        idle = false;
+    }
+}
+
+
+template <typename T, typename Comp>
+size_t
+avl_ingest<T, Comp>::drain(std::vector<op>& batch){
+
+    batch.clear();
+
+    while(batch.size() < max_batch){
+
+        op_node* node = dequeue();
+
+        if(node == nullptr)
+            break;
+
+        batch.push_back(node->value);
+        delete node;
+    }
+
+    dequeued += batch.size();
+    return batch.size();
+}
+
+
+template <typename T, typename Comp>
+void
+avl_ingest<T, Comp>::apply(std::vector<op>& batch){
+
+    size_t batch_size = batch.size();
+
+    // Stable, so the ops on one key keep their order and the last one wins:
+    std::stable_sort(batch.begin(), batch.end(),
+                     [&](const op& op1, const op& op2){ return less(op1.key, op2.key); });
+
+    size_t kept = 0;
+
+    for(size_t i = 0; i < batch.size(); i++){
+
+        if(i + 1 < batch.size() && !less(batch[i].key, batch[i + 1].key))
+            continue;
+
+        batch[kept++] = batch[i];
+    }
+
+    batch.erase(batch.begin() + kept, batch.end());
+    {
+        std::unique_lock<std::shared_mutex> guard(tree_lock);
+
+        // k ops one by one cost O(k*log(n)), a merge costs O(n + k):
+        size_t log_n = 1;
+        while((size_t(1) << log_n) < tree.size())
+            log_n++;
+
+        if(batch.size() * log_n < tree.size()){
+
+            for(const op& current : batch){
+
+                if(current.insert)
+                    tree.try_insert(current.key);
+                else
+                    tree.try_remove(current.key);
+            }
+        }
+        else{
+            mergeApply(batch);
+        }
+    }
+
+    collapsed += batch_size - batch.size();
+    batches++;
+    last_batch = batch_size;
+
+    if(batch_size > biggest_batch)
+        biggest_batch = batch_size;
+
+    applied += batch_size;
+    {
+        std::lock_guard<std::mutex> guard(wake_lock);
+    }
+    done.notify_all();
+}
+
+
+/* 'batch' is sorted with one op per key. Needs the write lock */
+template <typename T, typename Comp>
+void
+avl_ingest<T, Comp>::mergeApply(const std::vector<op>& batch){
+
+    std::vector<T> old_keys = tree.getAll();
+    std::vector<T> new_keys;
+    new_keys.reserve(old_keys.size() + batch.size());
+
+    size_t i = 0;
+
+    for(const op& current : batch){
+
+        while(i < old_keys.size() && less(old_keys[i], current.key))
+            new_keys.push_back(old_keys[i++]);
+
+        // the op decides if an equal old key stays:
+        if(i < old_keys.size() && !less(current.key, old_keys[i]))
+            i++;
+
+        if(current.insert)
+            new_keys.push_back(current.key);
+    }
+
+    new_keys.insert(new_keys.end(), old_keys.begin() + i, old_keys.end());
+
+    // built once & moved in (no copy of the nodes):
+    tree = tree_type(std::move(new_keys), comp, true);
+}
+
+
+template <typename T, typename Comp>
+bool
+avl_ingest<T, Comp>::less(const T& k1, const T& k2) const{
+    return avl_comp_traits<T, Comp>::less(comp, k1, k2);
+}
+
+
+#endif /* AVL_INGEST_H_ */
@@ -0,0 +1,386 @@
+#ifndef AVL_MAP_H_
+#define AVL_MAP_H_
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "avl_impl.h"
+
+
+/*
+ *  Ordered map on top of avl.
+ *
+ *  The tree nodes hold only the key and a pointer to the value,
+ *  so a search step brings the key into cache and not the payload.
+ *  Values live out of line: they never move on rotations
+ *  and can be mutated freely without breaking the ordering.
+ *
+ *  Type 'K' MUST SUPPORT Default C'tor (like 'T' of avl).
+ */
+
+template <typename K, typename V>
+struct avl_map_entry {
+    K key;
+    V* value;
+
+    avl_map_entry() : key(), value(nullptr){}
+    avl_map_entry(const K& key, V* value) : key(key), value(value){}
+};
+
+
+/* Keeps the kind of 'Comp': three-way stays three-way (see avl_comp_traits) */
+template <typename K, typename V, typename Comp, bool = avl_comp_traits<K, Comp>::three_way>
+struct avl_map_comp {
+    Comp comp;
+
+    explicit avl_map_comp(const Comp& comp = Comp()) : comp(comp){}
+
+    bool operator()(const avl_map_entry<K, V>& e1, const avl_map_entry<K, V>& e2) const{
+        return avl_comp_traits<K, Comp>::less(comp, e1.key, e2.key);
+    }
+};
+
+template <typename K, typename V, typename Comp>
+struct avl_map_comp<K, V, Comp, true> {
+    using is_three_way = void;
+
+    Comp comp;
+
+    explicit avl_map_comp(const Comp& comp = Comp()) : comp(comp){}
+
+    int operator()(const avl_map_entry<K, V>& e1, const avl_map_entry<K, V>& e2) const{
+        return avl_comp_traits<K, Comp>::compare(comp, e1.key, e2.key);
+    }
+};
+
+
+template <typename K, typename V, typename Comp = std::less<K>>
+class avl_map {
+    using entry = avl_map_entry<K, V>;
+    using entry_comp = avl_map_comp<K, V, Comp>;
+    using tree_type = avl<entry, entry_comp>;
+
+    tree_type tree;
+
+public:
+// Constractors:
+    avl_map();
+    explicit avl_map(const Comp& comp);
+    avl_map(const avl_map& src);
+    avl_map& operator=(const avl_map& src);
+    ~avl_map();
+
+// const-iterator over (key, value) pairs. The value is mutable:
+    class iterator {
+        typename tree_type::iterator it;
+
+        friend class avl_map;
+        explicit iterator(typename tree_type::iterator it) : it(it){}
+
+    public:
+        iterator() = default;
+
+        const K& key() const{ return (*it).key; }
+        V& value() const{ return *(*it).value; }
+        std::pair<const K&, V&> operator*() const{ return {key(), value()}; }
+
+        iterator& operator++(){ ++it; return *this; }
+        iterator operator++(int){ iterator ret_val = *this; ++it; return ret_val; }
+        bool operator==(const iterator& iter) const{ return it == iter.it; }
+        bool operator!=(const iterator& iter) const{ return it != iter.it; }
+    };
+
+// The same over a const map, the value is read-only too:
+    class const_iterator {
+        typename tree_type::iterator it;
+
+        friend class avl_map;
+        explicit const_iterator(typename tree_type::iterator it) : it(it){}
+
+    public:
+        const_iterator() = default;
+        const_iterator(const iterator& iter) : it(iter.it){}
+
+        const K& key() const{ return (*it).key; }
+        const V& value() const{ return *(*it).value; }
+        std::pair<const K&, const V&> operator*() const{ return {key(), value()}; }
+
+        const_iterator& operator++(){ ++it; return *this; }
+        const_iterator operator++(int){ const_iterator ret_val = *this; ++it; return ret_val; }
+        bool operator==(const const_iterator& iter) const{ return it == iter.it; }
+        bool operator!=(const const_iterator& iter) const{ return it != iter.it; }
+    };
+
+    iterator begin();
+    iterator end();
+
+// Operations:
+    V& operator[](const K& key);
+    V& at(const K& key);
+    const V& at(const K& key) const;
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const K& key, M&& obj);
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args);
+
+    void remove(const K& key);
+    bool try_remove(const K& key);
+    bool contains(const K& key) const;
+    iterator find(const K& key);
+    const_iterator find(const K& key) const;
+
+    size_t size() const;
+    bool empty() const;
+
+private:
+    /* Deletes the values. The tree itself is left untouched */
+    void freeValues();
+
+    std::vector<entry> cloneEntries() const;
+
+    static entry probe(const K& key);
+};
+
+
+/*   ***   Functor for internal use of constInorder   ***   */
+
+template <typename K, typename V>
+struct FreeValueFunctor {
+
+    void operator()(const avl_map_entry<K, V>& e){
+
+        delete e.value;
+    }
+};
+
+
+/*   ***   Constructors   ***   */
+
+template <typename K, typename V, typename Comp>
+avl_map<K, V, Comp>::avl_map()
+        : avl_map(Comp()){
+}
+
+template <typename K, typename V, typename Comp>
+avl_map<K, V, Comp>::avl_map(const Comp& comp)
+        : tree(entry_comp(comp)){
+}
+
+template <typename K, typename V, typename Comp>
+avl_map<K, V, Comp>::avl_map(const avl_map& src)
+        : tree(src.cloneEntries(), src.tree.key_comp(), true){
+}
+
+template <typename K, typename V, typename Comp>
+avl_map<K, V, Comp>&
+avl_map<K, V, Comp>::operator=(const avl_map& src){
+
+    if(this == &src)
+        return *this;
+
+    std::vector<entry> copy_elem = src.cloneEntries();
+
+    freeValues();
+    tree = tree_type(copy_elem, src.tree.key_comp(), true);
+
+    return *this;
+}
+
+template <typename K, typename V, typename Comp>
+avl_map<K, V, Comp>::~avl_map(){
+    freeValues();
+}
+
+
+/*   ***   iterator functions   ***   */
+
+template <typename K, typename V, typename Comp>
+typename avl_map<K, V, Comp>::iterator
+avl_map<K, V, Comp>::begin(){
+    return iterator(tree.begin());
+}
+
+template <typename K, typename V, typename Comp>
+typename avl_map<K, V, Comp>::iterator
+avl_map<K, V, Comp>::end(){
+    return iterator(tree.end());
+}
+
+
+/*   ***   Operations   ***   */
+
+template <typename K, typename V, typename Comp>
+V&
+avl_map<K, V, Comp>::operator[](const K& key){
+
+    return try_emplace(key).first.value();
+}
+
+
+template <typename K, typename V, typename Comp>
+V&
+avl_map<K, V, Comp>::at(const K& key){
+
+    iterator it = find(key);
+
+    if(it == iterator())
+        throw key_not_exist<K>(key);
+
+    return it.value();
+}
+
+template <typename K, typename V, typename Comp>
+const V&
+avl_map<K, V, Comp>::at(const K& key) const{
+
+    const_iterator it = find(key);
+
+    if(it == const_iterator())
+        throw key_not_exist<K>(key);
+
+    return it.value();
+}
+
+
+template <typename K, typename V, typename Comp>
+template <typename M>
+std::pair<typename avl_map<K, V, Comp>::iterator, bool>
+avl_map<K, V, Comp>::insert_or_assign(const K& key, M&& obj){
+
+    iterator it = find(key);
+
+    if(it != end()){
+
+        it.value() = std::forward<M>(obj);
+        return std::make_pair(it, false);
+    }
+
+    return try_emplace(key, std::forward<M>(obj));
+}
+
+
+template <typename K, typename V, typename Comp>
+template <typename... Args>
+std::pair<typename avl_map<K, V, Comp>::iterator, bool>
+avl_map<K, V, Comp>::try_emplace(const K& key, Args&&... args){
+
+    // The value is built only when the key is new:
+    iterator it = find(key);
+
+    if(it != end())
+        return std::make_pair(it, false);
+
+    V* value = new V(std::forward<Args>(args)...);
+
+    try{
+        return std::make_pair(iterator(tree.try_insert(entry(key, value)).first), true);
+    }
+    catch(...){
+        delete value;
+        throw;
+    }
+}
+
+
+template <typename K, typename V, typename Comp>
+void
+avl_map<K, V, Comp>::remove(const K& key){
+
+    if(!try_remove(key))
+        throw key_not_exist<K>(key);
+}
+
+
+template <typename K, typename V, typename Comp>
+bool
+avl_map<K, V, Comp>::try_remove(const K& key){
+
+    iterator it = find(key);
+
+    if(it == end())
+        return false;
+
+    // Entries are copied around inside the tree, the value is not:
+    V* value = &it.value();
+
+    tree.remove(probe(key));
+    delete value;
+    return true;
+}
+
+
+template <typename K, typename V, typename Comp>
+bool
+avl_map<K, V, Comp>::contains(const K& key) const{
+    return tree.contains(probe(key));
+}
+
+template <typename K, typename V, typename Comp>
+typename avl_map<K, V, Comp>::iterator
+avl_map<K, V, Comp>::find(const K& key){
+    return iterator(tree.find(probe(key)));
+}
+
+template <typename K, typename V, typename Comp>
+typename avl_map<K, V, Comp>::const_iterator
+avl_map<K, V, Comp>::find(const K& key) const{
+    return const_iterator(tree.find(probe(key)));
+}
+
+template <typename K, typename V, typename Comp>
+size_t
+avl_map<K, V, Comp>::size() const{
+    return tree.size();
+}
+
+template <typename K, typename V, typename Comp>
+bool
+avl_map<K, V, Comp>::empty() const{
+    return tree.empty();
+}
+
+
+/*   ***   Private methods   ***   */
+
+template <typename K, typename V, typename Comp>
+void
+avl_map<K, V, Comp>::freeValues(){
+
+    FreeValueFunctor<K, V> functor;
+
+    tree.constInorder(functor);
+}
+
+
+template <typename K, typename V, typename Comp>
+std::vector<typename avl_map<K, V, Comp>::entry>
+avl_map<K, V, Comp>::cloneEntries() const{
+
+    std::vector<entry> copy_elem = tree.getAll();
+    size_t cloned = 0;
+
+    try{
+        for(; cloned < copy_elem.size(); cloned++)
+            copy_elem[cloned].value = new V(*copy_elem[cloned].value);
+    }
+    catch(...){
+        for(size_t i = 0; i < cloned; i++)
+            delete copy_elem[i].value;
+        throw;
+    }
+
+    return copy_elem;
+}
+
+
+template <typename K, typename V, typename Comp>
+typename avl_map<K, V, Comp>::entry
+avl_map<K, V, Comp>::probe(const K& key){
+    return entry(key, nullptr);
+}
+
+
+#endif /* AVL_MAP_H_ */
@@ -5,7 +5,7 @@
 template <class T>
 struct node {
     T key;
-    int height;
+    int height;     // a rank with the WAVL & red-black policies (avl_balance.h)
     size_t weight;
     node* left;
     node* right;
@@ -0,0 +1,772 @@
+#ifndef AVL_SHARDED_H_
+#define AVL_SHARDED_H_
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "avl_impl.h"
+
+
+/*
+ *  Ordered set, cut by key ranges into shards.
+ *  Each shard is an avl with its own mutex, so writers of different ranges
+ *  do not wait for each other.
+ *
+ *  A shard that grows over 'max_shard_size' is split at its median.
+ *  A shard that shrinks under a quarter of it is merged into a neighbour,
+ *  unless the boundary between them was given to the C'tor.
+ *
+ *  Locking: the boundaries are an immutable table behind an atomic pointer.
+ *  An operation reads the table with no lock, locks its shard, and checks there
+ *  that no split or merge has retired the shard meanwhile (if one has, it starts over).
+ *  So the only shared writes of an operation are to its own shard.
+ *  Split & merge are serialized with each other only. They build the new shards
+ *  under the mutexes of the old ones and publish a new table with one store.
+ *  An old table is freed once no thread reads it (see avl_shard_hazard).
+ *
+ *  rank(), select(), size() and getAll() add up per-shard counts and lock one shard
+ *  at a time, so while writers run they see each shard at its own moment.
+ *  The iterator takes no lock: use it while no writer runs, or use getAll().
+ */
+
+
+/*   ***   Hazard records   ***   */
+
+/* One per thread, shared by every avl_sharded: the table the thread reads, if any */
+struct alignas(64) avl_shard_hazard {
+    std::atomic<const void*> table{nullptr};
+    std::atomic<bool> in_use{false};
+    avl_shard_hazard* next = nullptr;
+};
+
+/* Records are reused by later threads and never freed */
+inline std::atomic<avl_shard_hazard*> avl_shard_hazards{nullptr};
+
+/* Holds a free record, or adds one, for the life of the thread */
+struct avl_shard_hazard_owner {
+    avl_shard_hazard* record;
+
+    avl_shard_hazard_owner(){
+
+        for(record = avl_shard_hazards.load(std::memory_order_acquire); record; record = record->next){
+
+            bool free_record = false;
+
+            if(record->in_use.compare_exchange_strong(free_record, true))
+                return;
+        }
+
+        record = new avl_shard_hazard;
+        record->in_use.store(true, std::memory_order_relaxed);
+        record->next = avl_shard_hazards.load(std::memory_order_relaxed);
+
+        while(!avl_shard_hazards.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                                       std::memory_order_relaxed));
+    }
+
+    ~avl_shard_hazard_owner(){
+
+        record->table.store(nullptr, std::memory_order_release);
+        record->in_use.store(false, std::memory_order_release);
+    }
+};
+
+inline std::atomic<const void*>&
+avlShardHazard(){
+
+    thread_local avl_shard_hazard_owner owner;
+    return owner.record->table;
+}
+
+
+template <typename T, typename Comp = std::less<T>, typename Balance = avl_balance>
+class avl_sharded {
+    using tree_type = avl<T, Comp, avl_no_stats, Balance>;
+
+    /* Its own cache line, so the writers of neighbour shards don't share one */
+    struct alignas(64) shard {
+        mutable std::mutex lock;
+        tree_type tree;
+        bool pinned;                // its 'low' was given to the C'tor, so it is never merged away
+        bool retired;               // replaced by a split or a merge. Under 'lock'
+        std::atomic<size_t> count;  // tree.size(), readable without the lock
+
+        shard(const std::vector<T>& sorted_elements, const Comp& comp, bool pinned)
+                : tree(sorted_elements, comp, true), pinned(pinned), retired(false),
+                  count(sorted_elements.size()){}
+    };
+
+    /* Never changed once published. lows[i] is the least key of shards[i] (lows[0] is unused) */
+    struct table {
+        std::vector<T> lows;
+        std::vector<shard*> shards;
+    };
+
+    /* A published table and the shards that left with it, freed together */
+    struct retired_table {
+        const table* snapshot;
+        std::vector<shard*> gone;
+    };
+
+    std::atomic<const table*> current;
+    size_t max_shard_size;
+    Comp comp;
+
+    std::mutex resize_lock;                 // serializes split & merge. Not taken by the operations
+    std::deque<retired_table> retired;      // oldest first. Under 'resize_lock'
+
+public:
+// Constractors:
+    explicit avl_sharded(size_t max_shard_size = 1 << 16, const Comp& comp = Comp());
+
+    /* One shard per range: (-inf, bounds[0]), [bounds[0], bounds[1]), ... */
+    avl_sharded(const std::vector<T>& sorted_bounds, size_t max_shard_size = 1 << 16,
+                const Comp& comp = Comp());
+
+    avl_sharded(const avl_sharded&) = delete;
+    avl_sharded& operator=(const avl_sharded&) = delete;
+    ~avl_sharded();
+
+// Operations:
+    void insert(const T& element);
+    void remove(const T& element);
+    bool try_insert(const T& element);
+    bool try_remove(const T& element);
+    bool contains(const T& element) const;
+
+    size_t rank(const T& key) const;
+    T select(size_t index) const;
+
+    size_t size() const;
+    bool empty() const;
+    size_t shard_count() const;
+    std::vector<T> getAll() const;
+
+// const-iterator, crosses the shards in order:
+    class iterator {
+        const table* snapshot;
+        size_t index;
+        typename tree_type::iterator it;
+
+        friend class avl_sharded;
+
+        iterator(const table* snapshot, size_t index) : snapshot(snapshot), index(index){
+            seek();
+        }
+
+        /* Moves to the first key of shards[index], or of the next non-empty shard */
+        void seek(){
+
+            for(; index < snapshot->shards.size(); index++){
+
+                it = snapshot->shards[index]->tree.begin();
+
+                if(it != snapshot->shards[index]->tree.end())
+                    return;
+            }
+
+            it = typename tree_type::iterator();
+        }
+
+    public:
+        iterator() : snapshot(nullptr), index(0){}
+
+        const T& operator*() const{ return *it; }
+
+        iterator& operator++(){
+
+            if(++it == snapshot->shards[index]->tree.end()){
+
+                index++;
+                seek();
+            }
+
+            return *this;
+        }
+
+        iterator operator++(int){ iterator ret_val = *this; ++(*this); return ret_val; }
+        bool operator==(const iterator& iter) const{ return index == iter.index && it == iter.it; }
+        bool operator!=(const iterator& iter) const{ return !(*this == iter); }
+    };
+
+    iterator begin() const;
+    iterator end() const;
+
+private:
+    /* The current table, published in the thread's hazard record until the hold ends */
+    class table_hold {
+        std::atomic<const void*>& hazard;
+    public:
+        const table& snapshot;
+
+        explicit table_hold(const avl_sharded& owner);
+        ~table_hold();
+        table_hold(const table_hold&) = delete;
+        table_hold& operator=(const table_hold&) = delete;
+    };
+
+    bool less(const T& k1, const T& k2) const;
+
+    /* The shard of 'snapshot' whose range holds 'key' */
+    size_t shardOf(const table& snapshot, const T& key) const;
+
+    /* Runs func(shard&) under the mutex of the shard of 'key'. Starts over if it was retired */
+    template <typename Func>
+    auto withShard(const T& key, Func func) const;
+
+    void splitShard(const T& key);
+    void mergeShard(const T& key);
+
+    /* From the counts, with no lock: the shard of 'key' has a neighbour it may merge with.
+     * Keeps the removes on a lone or pinned shard off 'resize_lock' */
+    bool mergeable(const T& key) const;
+
+    /* Needs 'resize_lock'. Replaces shards[first, last) of the current table by 'added' */
+    void publish(size_t first, size_t last, std::vector<shard*> added, std::vector<T> added_lows);
+    void reclaim();
+};
+
+
+/*   ***   Constructors   ***   */
+
+template <typename T, typename Comp, typename Balance>
+avl_sharded<T, Comp, Balance>::avl_sharded(size_t max_shard_size, const Comp& comp)
+        : avl_sharded(std::vector<T>(), max_shard_size, comp){
+}
+
+template <typename T, typename Comp, typename Balance>
+avl_sharded<T, Comp, Balance>::avl_sharded(const std::vector<T>& sorted_bounds,
+                                           size_t max_shard_size, const Comp& comp)
+        : current(nullptr), max_shard_size(max_shard_size), comp(comp){
+
+    table* first = new table;
+
+    first->lows.push_back(T());
+    first->shards.push_back(new shard(std::vector<T>(), comp, false));
+
+    for(const T& bound : sorted_bounds){
+
+        first->lows.push_back(bound);
+        first->shards.push_back(new shard(std::vector<T>(), comp, true));
+    }
+
+    current.store(first, std::memory_order_release);
+}
+
+
+/* No thread reads the tables anymore, so every retired one goes now */
+template <typename T, typename Comp, typename Balance>
+avl_sharded<T, Comp, Balance>::~avl_sharded(){
+
+    for(retired_table& old : retired){
+
+        for(shard* gone : old.gone)
+            delete gone;
+
+        delete old.snapshot;
+    }
+
+    const table* last = current.load(std::memory_order_acquire);
+
+    for(shard* s : last->shards)
+        delete s;
+
+    delete last;
+}
+
+
+/*   ***   Operations   ***   */
+
+template <typename T, typename Comp, typename Balance>
+void
+avl_sharded<T, Comp, Balance>::insert(const T& element){
+
+    if(!try_insert(element))
+        throw key_already_exists<T>(element);
+}
+
+
+template <typename T, typename Comp, typename Balance>
+void
+avl_sharded<T, Comp, Balance>::remove(const T& element){
+
+    if(!try_remove(element))
+        throw key_not_exist<T>(element);
+}
+
+
+template <typename T, typename Comp, typename Balance>
+bool
+avl_sharded<T, Comp, Balance>::try_insert(const T& element){
+
+    bool too_big = false;
+
+    bool inserted = withShard(element, [&](shard& target){
+
+        bool added = target.tree.try_insert(element).second;
+
+        target.count.store(target.tree.size(), std::memory_order_relaxed);
+        too_big = target.tree.size() > max_shard_size;
+
+        return added;
+    });
+
+    if(too_big)
+        splitShard(element);
+
+    return inserted;
+}
+
+
+template <typename T, typename Comp, typename Balance>
+bool
+avl_sharded<T, Comp, Balance>::try_remove(const T& element){
+
+    bool too_small = false;
+
+    bool removed = withShard(element, [&](shard& target){
+
+        bool erased = target.tree.try_remove(element);
+
+        target.count.store(target.tree.size(), std::memory_order_relaxed);
+        too_small = erased && target.tree.size() < max_shard_size / 4;
+
+        return erased;
+    });
+
+    if(too_small && mergeable(element))
+        mergeShard(element);
+
+    return removed;
+}
+
+
+template <typename T, typename Comp, typename Balance>
+bool
+avl_sharded<T, Comp, Balance>::contains(const T& element) const{
+
+    return withShard(element, [&](const shard& target){
+        return target.tree.contains(element);
+    });
+}
+
+
+/* The shards before the key's shard are counted by their counts */
+template <typename T, typename Comp, typename Balance>
+size_t
+avl_sharded<T, Comp, Balance>::rank(const T& key) const{
+
+    while(true){
+
+        table_hold hold(*this);
+        size_t target = shardOf(hold.snapshot, key);
+        size_t rank = 0;
+
+        for(size_t i = 0; i < target; i++)
+            rank += hold.snapshot.shards[i]->count.load(std::memory_order_relaxed);
+
+        const shard& found = *hold.snapshot.shards[target];
+        std::lock_guard<std::mutex> guard(found.lock);
+
+        if(!found.retired)
+            return rank + found.tree.rank(key);
+    }
+}
+
+
+/* Like avl::select, an index out of range gives the min or the max */
+template <typename T, typename Comp, typename Balance>
+T
+avl_sharded<T, Comp, Balance>::select(size_t index) const{
+
+    while(true){
+
+        table_hold hold(*this);
+        const shard* last = nullptr;
+        size_t left = index;
+        bool stale = false;
+
+        // The counts skip the shards before the index, then its shard is locked:
+        for(const shard* s : hold.snapshot.shards){
+
+            size_t count = s->count.load(std::memory_order_relaxed);
+
+            if(count == 0)
+                continue;
+
+            if(left > count){
+
+                left -= count;
+                last = s;
+                continue;
+            }
+
+            std::lock_guard<std::mutex> guard(s->lock);
+
+            if(s->retired){
+
+                stale = true;
+                break;
+            }
+
+            if(left <= s->tree.size() && !s->tree.empty())
+                return s->tree.select(left);
+
+            // it shrank since its count was read:
+            left -= s->tree.size();
+
+            if(!s->tree.empty())
+                last = s;
+        }
+
+        if(stale)
+            continue;
+
+        if(last == nullptr)
+            throw tree_is_empty();
+
+        std::lock_guard<std::mutex> guard(last->lock);
+
+        if(!last->retired && !last->tree.empty())
+            return last->tree.getMax();
+    }
+}
+
+
+template <typename T, typename Comp, typename Balance>
+size_t
+avl_sharded<T, Comp, Balance>::size() const{
+
+    table_hold hold(*this);
+    size_t total = 0;
+
+    for(const shard* s : hold.snapshot.shards)
+        total += s->count.load(std::memory_order_relaxed);
+
+    return total;
+}
+
+template <typename T, typename Comp, typename Balance>
+bool
+avl_sharded<T, Comp, Balance>::empty() const{
+    return size() == 0;
+}
+
+template <typename T, typename Comp, typename Balance>
+size_t
+avl_sharded<T, Comp, Balance>::shard_count() const{
+
+    table_hold hold(*this);
+    return hold.snapshot.shards.size();
+}
+
+
+template <typename T, typename Comp, typename Balance>
+std::vector<T>
+avl_sharded<T, Comp, Balance>::getAll() const{
+
+    std::vector<T> all;
+
+    // A shard retired on the way holds its keys as of then, so the copy starts over:
+    for(bool stale = true; stale; ){
+
+        table_hold hold(*this);
+        stale = false;
+        all.clear();
+
+        for(const shard* s : hold.snapshot.shards){
+
+            std::lock_guard<std::mutex> guard(s->lock);
+
+            if(s->retired){
+
+                stale = true;
+                break;
+            }
+
+            std::vector<T> part = s->tree.getAll();
+            all.insert(all.end(), part.begin(), part.end());
+        }
+    }
+
+    return all;
+}
+
+
+/*   ***   iterator functions   ***   */
+
+template <typename T, typename Comp, typename Balance>
+typename avl_sharded<T, Comp, Balance>::iterator
+avl_sharded<T, Comp, Balance>::begin() const{
+    return iterator(current.load(std::memory_order_acquire), 0);
+}
+
+template <typename T, typename Comp, typename Balance>
+typename avl_sharded<T, Comp, Balance>::iterator
+avl_sharded<T, Comp, Balance>::end() const{
+
+    const table* snapshot = current.load(std::memory_order_acquire);
+
+    return iterator(snapshot, snapshot->shards.size());
+}
+
+
+/*   ***   Private methods   ***   */
+
+/*
+ *  The hazard is stored before 'current' is read again, and a resizer swaps 'current'
+ *  before it reads the hazards. So either the resizer sees the hazard and keeps
+ *  the table, or this thread sees the new table and tries again (all seq_cst).
+ */
+template <typename T, typename Comp, typename Balance>
+avl_sharded<T, Comp, Balance>::table_hold::table_hold(const avl_sharded& owner)
+        : hazard(avlShardHazard()),
+          snapshot([&]() -> const table& {
+
+              const table* seen = owner.current.load(std::memory_order_acquire);
+
+              while(true){
+
+                  hazard.store(seen);
+                  const table* again = owner.current.load();
+
+                  if(again == seen)
+                      return *seen;
+
+                  seen = again;
+              }
+          }()){
+}
+
+template <typename T, typename Comp, typename Balance>
+avl_sharded<T, Comp, Balance>::table_hold::~table_hold(){
+    hazard.store(nullptr, std::memory_order_release);
+}
+
+
+template <typename T, typename Comp, typename Balance>
+bool
+avl_sharded<T, Comp, Balance>::less(const T& k1, const T& k2) const{
+    return avl_comp_traits<T, Comp>::less(comp, k1, k2);
+}
+
+
+template <typename T, typename Comp, typename Balance>
+size_t
+avl_sharded<T, Comp, Balance>::shardOf(const table& snapshot, const T& key) const{
+
+    // the first shard with low > key, minus one:
+    size_t low = 1, high = snapshot.lows.size();
+
+    while(low < high){
+
+        size_t mid = low + (high - low) / 2;
+
+        if(less(key, snapshot.lows[mid]))
+            high = mid;
+        else
+            low = mid + 1;
+    }
+
+    return low - 1;
+}
+
+
+template <typename T, typename Comp, typename Balance>
+template <typename Func>
+auto
+avl_sharded<T, Comp, Balance>::withShard(const T& key, Func func) const{
+
+    while(true){
+
+        table_hold hold(*this);
+        shard& target = *hold.snapshot.shards[shardOf(hold.snapshot, key)];
+        std::lock_guard<std::mutex> guard(target.lock);
+
+        if(!target.retired)
+            return func(target);
+    }
+}
+
+
+/* O(max_shard_size), under the shard's own mutex only. The new boundary is the median */
+template <typename T, typename Comp, typename Balance>
+void
+avl_sharded<T, Comp, Balance>::splitShard(const T& key){
+
+    std::lock_guard<std::mutex> resizing(resize_lock);
+
+    // only resizers swap the table, so it can be read with no hazard here:
+    const table& snapshot = *current.load(std::memory_order_acquire);
+    size_t target = shardOf(snapshot, key);
+    shard& old = *snapshot.shards[target];
+    {
+        std::lock_guard<std::mutex> guard(old.lock);
+
+        // another writer may have split it first:
+        if(old.tree.size() <= max_shard_size)
+            return;
+
+        std::vector<T> elements = old.tree.getAll();
+        size_t half = elements.size() / 2;
+        std::vector<T> upper_elements(elements.begin() + half, elements.end());
+        elements.erase(elements.begin() + half, elements.end());
+
+        T upper_low = upper_elements.front();
+        shard* lower = new shard(elements, comp, old.pinned);
+        shard* upper = new shard(upper_elements, comp, false);
+
+        publish(target, target + 1, {lower, upper}, {snapshot.lows[target], upper_low});
+
+        // the writers waiting for 'old' start over on the new table:
+        old.retired = true;
+    }
+
+    reclaim();
+}
+
+
+template <typename T, typename Comp, typename Balance>
+bool
+avl_sharded<T, Comp, Balance>::mergeable(const T& key) const{
+
+    table_hold hold(*this);
+    const table& snapshot = hold.snapshot;
+    size_t target = shardOf(snapshot, key);
+
+    for(size_t left : {target, target - 1}){
+
+        // the same pairs as mergeShard (target - 1 wraps for the first shard):
+        if(left >= snapshot.shards.size() - 1 || snapshot.shards[left + 1]->pinned)
+            continue;
+
+        size_t together = snapshot.shards[left]->count.load(std::memory_order_relaxed) +
+                          snapshot.shards[left + 1]->count.load(std::memory_order_relaxed);
+
+        if(together <= max_shard_size / 2)
+            return true;
+    }
+
+    return false;
+}
+
+
+/*
+ *  Merges a small shard with its right neighbour, or else with its left one.
+ *  A neighbour is skipped if the boundary is pinned or the two hold over max_shard_size / 2.
+ */
+template <typename T, typename Comp, typename Balance>
+void
+avl_sharded<T, Comp, Balance>::mergeShard(const T& key){
+
+    std::lock_guard<std::mutex> resizing(resize_lock);
+
+    // A run of small shards is merged one neighbour at a time:
+    for(bool merged = true; merged; ){
+
+        merged = false;
+
+        const table& snapshot = *current.load(std::memory_order_acquire);
+        size_t target = shardOf(snapshot, key);
+
+        if(snapshot.shards[target]->count.load(std::memory_order_relaxed) >= max_shard_size / 4)
+            break;
+
+        for(size_t left : {target, target - 1}){
+
+            // merges shards[left] and shards[left + 1] (target - 1 wraps for the first shard):
+            if(left >= snapshot.shards.size() - 1 || snapshot.shards[left + 1]->pinned)
+                continue;
+
+            shard& lower = *snapshot.shards[left];
+            shard& upper = *snapshot.shards[left + 1];
+
+            // in key order, and no operation holds two shards, so no deadlock:
+            std::lock_guard<std::mutex> lower_guard(lower.lock);
+            std::lock_guard<std::mutex> upper_guard(upper.lock);
+
+            if(snapshot.shards[target]->tree.size() >= max_shard_size / 4)
+                break;
+
+            if(lower.tree.size() + upper.tree.size() > max_shard_size / 2)
+                continue;
+
+            std::vector<T> elements = lower.tree.getAll();
+            std::vector<T> upper_elements = upper.tree.getAll();
+            elements.insert(elements.end(), upper_elements.begin(), upper_elements.end());
+
+            shard* joined = new shard(elements, comp, lower.pinned);
+
+            publish(left, left + 2, {joined}, {snapshot.lows[left]});
+
+            lower.retired = upper.retired = true;
+            merged = true;
+            break;
+        }
+    }
+
+    reclaim();
+}
+
+
+template <typename T, typename Comp, typename Balance>
+void
+avl_sharded<T, Comp, Balance>::publish(size_t first, size_t last, std::vector<shard*> added,
+                                       std::vector<T> added_lows){
+
+    const table* old = current.load(std::memory_order_acquire);
+    table* next = new table;
+
+    next->lows.assign(old->lows.begin(), old->lows.begin() + first);
+    next->lows.insert(next->lows.end(), added_lows.begin(), added_lows.end());
+    next->lows.insert(next->lows.end(), old->lows.begin() + last, old->lows.end());
+
+    next->shards.assign(old->shards.begin(), old->shards.begin() + first);
+    next->shards.insert(next->shards.end(), added.begin(), added.end());
+    next->shards.insert(next->shards.end(), old->shards.begin() + last, old->shards.end());
+
+    current.store(next);
+
+    retired.push_back(retired_table{old, std::vector<shard*>(old->shards.begin() + first,
+                                                             old->shards.begin() + last)});
+}
+
+
+/*
+ *  Needs 'resize_lock'. Frees the retired tables that no thread reads, oldest first.
+ *  A retired shard is in its own table and in older ones only,
+ *  so it goes with its table once the older ones are gone.
+ */
+template <typename T, typename Comp, typename Balance>
+void
+avl_sharded<T, Comp, Balance>::reclaim(){
+
+    std::vector<const void*> hazards;
+
+    for(avl_shard_hazard* record = avl_shard_hazards.load(std::memory_order_acquire); record;
+        record = record->next){
+
+        if(const void* read = record->table.load())
+            hazards.push_back(read);
+    }
+
+    while(!retired.empty()){
+
+        retired_table& oldest = retired.front();
+
+        if(std::find(hazards.begin(), hazards.end(), oldest.snapshot) != hazards.end())
+            break;
+
+        for(shard* gone : oldest.gone)
+            delete gone;
+
+        delete oldest.snapshot;
+        retired.pop_front();
+    }
+}
+
+
+#endif /* AVL_SHARDED_H_ */
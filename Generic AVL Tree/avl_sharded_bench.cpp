@@ -0,0 +1,114 @@
+/*
+ *  Write scaling of avl_sharded (avl_sharded.h) with the number of threads.
+ *
+ *  Each thread works in its own key range (its own disk region): a mix of
+ *  insert, remove & contains on random keys of the range. The same work runs
+ *  on an avl_sharded and on one avl behind one std::mutex.
+ *  The speedup is against one thread of the same set; close to the number of
+ *  threads is linear. It can't pass the number of cores, printed first.
+ *
+ *  Build & run:
+ *      g++ -std=c++17 -O2 -DNDEBUG -pthread avl_sharded_bench.cpp -o avl_sharded_bench
+ *      ./avl_sharded_bench
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "avl_sharded.h"
+
+
+/* One avl behind one lock, the baseline */
+struct locked_avl {
+    std::mutex lock;
+    avl<int> tree;
+
+    bool try_insert(int key){ std::lock_guard<std::mutex> guard(lock); return tree.try_insert(key).second; }
+    bool try_remove(int key){ std::lock_guard<std::mutex> guard(lock); return tree.try_remove(key); }
+    bool contains(int key){ std::lock_guard<std::mutex> guard(lock); return tree.contains(key); }
+};
+
+
+/* Millions of operations per second, over all the threads */
+template <typename Set>
+double mopsPerSecond(Set& set, unsigned threads, size_t ops_per_thread, size_t& hits){
+
+    const int region = 1 << 24;
+    const int keys_per_region = 1 << 18;
+    std::vector<size_t> found(threads, 0);
+    std::vector<std::thread> workers;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(unsigned t = 0; t < threads; t++){
+
+        workers.emplace_back([&, t]{
+
+            std::mt19937 gen(t + 1);
+            size_t local = 0;
+
+            for(size_t i = 0; i < ops_per_thread; i++){
+
+                int key = int(t) * region + int(gen() % keys_per_region);
+
+                switch(gen() % 4){
+                case 0:
+                case 1:  local += set.try_insert(key); break;
+                case 2:  local += set.try_remove(key); break;
+                default: local += set.contains(key);
+                }
+            }
+
+            found[t] = local;
+        });
+    }
+
+    for(std::thread& worker : workers)
+        worker.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    for(size_t count : found)
+        hits += count;
+
+    return threads * ops_per_thread / elapsed.count() / 1e6;
+}
+
+
+int main(){
+
+    const size_t ops_per_thread = 1000000;
+    unsigned cores = std::thread::hardware_concurrency();
+    unsigned max_threads = cores > 8 ? cores : 8;
+
+    std::printf("cores: %u\n", cores);
+    std::printf("%8s %14s %10s %14s %10s\n", "threads", "sharded Mops", "speedup", "locked Mops", "speedup");
+
+    double sharded_one = 0, locked_one = 0;
+    size_t hits = 0;
+
+    for(unsigned threads = 1; threads <= max_threads; threads *= 2){
+
+        avl_sharded<int> sharded(1 << 14);
+        locked_avl locked;
+
+        double sharded_mops = mopsPerSecond(sharded, threads, ops_per_thread, hits);
+        double locked_mops = mopsPerSecond(locked, threads, ops_per_thread, hits);
+
+        if(threads == 1){
+
+            sharded_one = sharded_mops;
+            locked_one = locked_mops;
+        }
+
+        std::printf("%8u %14.2f %9.2fx %14.2f %9.2fx   (%zu shards, %zu)\n",
+                    threads, sharded_mops, sharded_mops / sharded_one,
+                    locked_mops, locked_mops / locked_one, sharded.shard_count(), hits);
+    }
+
+    return 0;
+}
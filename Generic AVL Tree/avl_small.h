@@ -0,0 +1,1128 @@
+#ifndef AVL_SMALL_H_
+#define AVL_SMALL_H_
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "avl_impl.h"
+
+
+/*
+ *  avl with a small-size mode.
+ *
+ *  Up to 'N' keys are kept sorted in an array inside the object: no node is allocated,
+ *  and a search is a branch-free count over the array, which the compiler
+ *  vectorizes for arithmetic keys with std::less.
+ *  Inserting key N+1 moves the keys into an avl. Removing down to N/2 keys
+ *  moves them back, so a tree at the threshold doesn't switch on every call.
+ *
+ *  The API is avl's. In tree mode a call goes straight to the tree.
+ *  Inline, the array answers it, except the set algebra with a tree,
+ *  which moves the inline keys into a tree first.
+ *  Not offered: preorder & postorder (there is no tree shape inline) and getCopy (a TODO of avl).
+ *
+ *  'Stats' counts the comparisons of the inline mode too. The tree's counters
+ *  are dropped with the tree when the keys move back inline.
+ *  Iterators are invalidated by insert & remove, like those of avl.
+ */
+
+template <typename T, size_t N = 16, typename Comp = std::less<T>, typename Stats = avl_no_stats,
+          typename Balance = avl_balance>
+class avl_small : private avl_ebo<Comp, 0>, private avl_ebo<Stats, 1> {
+    using tree_type = avl<T, Comp, Stats, Balance>;
+
+    struct inline_keys {
+        T keys[N];
+        size_t count = 0;
+    };
+
+    std::variant<inline_keys, tree_type> store;
+
+public:
+    Comp key_comp() const;
+
+// Constractors:
+    avl_small();
+    explicit avl_small(const Comp& comp);
+
+    /* More than N keys go straight into a tree, built in O(size) */
+    explicit avl_small(std::vector<T> elements, bool sorted = false);
+    avl_small(std::vector<T> elements, const Comp& comp, bool sorted = false);
+    avl_small(T* elements, size_t arr_size, bool sorted = false);
+    avl_small(T* elements, size_t arr_size, const Comp& comp, bool sorted = false);
+
+// Operations:
+    void insert(T element);
+    void remove(const T element);
+    bool contains(const T& element) const;
+
+    size_t rank(const T& key) const;
+    const T& select(size_t index) const;
+
+/* Batch order statistics (see avl) */
+    std::vector<T> select_many(const std::vector<size_t>& sorted_indices) const;
+    std::vector<T> quantiles(size_t k) const;
+    std::vector<size_t> rank_many(const std::vector<T>& sorted_keys) const;
+
+    T& getRef(const T& key);
+    const T& getMin() const;
+    const T& getMax() const;
+    T popMin();
+    T popMax();
+    size_t size() const;
+    bool empty() const;
+    std::vector<T> getAll() const;
+
+    /* true while the keys are in the inline array */
+    bool is_inline() const;
+
+// Bounded insert (see avl::offer & avl_topk.h):
+    bool offer(T element, size_t capacity, AVL_EVICT evict = EVICT_MIN);
+    size_t shrink_to(size_t capacity, AVL_EVICT evict = EVICT_MIN);
+
+// Memory layout (see avl::compact). Nothing to do inline:
+    void compact(AVL_LAYOUT layout = VAN_EMDE_BOAS);
+
+// Instrumentation:
+    avl_stats_snapshot stats() const;
+    void resetStats();
+
+// const-iterator:
+    class iterator {
+        const T* key;                           // inline mode, null at the end
+        const T* last;
+        typename tree_type::iterator it;        // tree mode
+
+        friend class avl_small;
+        iterator(const T* key, const T* last) : key(key), last(last){}
+        explicit iterator(typename tree_type::iterator it) : key(nullptr), last(nullptr), it(it){}
+
+    public:
+        iterator() : key(nullptr), last(nullptr){}
+
+        const T& operator*() const{ return key ? *key : *it; }
+
+        iterator& operator++(){
+
+            if(key == nullptr)
+                ++it;
+            else if(++key == last)
+                key = nullptr;
+
+            return *this;
+        }
+
+        iterator operator++(int){ iterator ret_val = *this; ++(*this); return ret_val; }
+        bool operator==(const iterator& iter) const{ return key == iter.key && it == iter.it; }
+        bool operator!=(const iterator& iter) const{ return !(*this == iter); }
+    };
+
+    iterator begin();
+    iterator end();
+
+/* Hinted insert (see avl). Inline, the hint saves nothing over the array count */
+    iterator insert(iterator hint, T element);
+
+/* Bulk removal (see avl). Each returns the number of keys removed */
+    size_t erase(iterator first, iterator last);
+    size_t erase_range(const T from, const T to);       // [from, to)
+    template <typename Pred>
+    size_t erase_if(Pred pred);
+
+// Set algebra (see avl). The result replaces this set, an rvalue 'other' is left empty:
+    void set_union(const avl_small& other);
+    void set_union(avl_small&& other);
+    void set_intersection(const avl_small& other);
+    void set_intersection(avl_small&& other);
+    void set_difference(const avl_small& other);          // this \ other
+    void set_difference(avl_small&& other);
+    void symmetric_difference(const avl_small& other);
+    void symmetric_difference(avl_small&& other);
+
+// Non-throwing lookup & update (for hot paths):
+    std::pair<iterator, bool> try_insert(T element);
+    bool try_remove(const T& element);
+    iterator find(const T& key) const;
+
+// Tree Traversals (in order only):
+    template <typename Functor>
+    void inorder(Functor& func);
+
+// Early-exit scans (see avl::scan):
+    template <typename Visitor>
+    size_t scan(const T& start, Visitor visitor) const;
+
+    template <typename Visitor>
+    size_t scan(Visitor visitor) const;
+
+// Const Tree Traversals (for read-only use):
+    template <typename Functor>
+    void constInorder(Functor& func) const;
+
+private:
+    bool less(const T& k1, const T& k2) const;
+    const Comp& keyComp() const;
+    const Stats& statsPolicy() const;
+
+    /* Number of inline keys less than 'key' */
+    size_t lowerBound(const inline_keys& small, const T& key) const;
+    bool foundAt(const inline_keys& small, size_t pos, const T& key) const;
+
+    /* Removes small.keys[from, to) */
+    size_t eraseInline(inline_keys& small, size_t from, size_t to);
+
+    void toTree();
+    void toInline();
+
+    /* After a removal in tree mode: back to the array at N/2 keys or fewer */
+    void fitInline();
+
+    /* Replaces the keys by 'sorted_elem' (sorted & unique), inline if they fit */
+    void assignSorted(std::vector<T>& sorted_elem);
+
+    void setAlgebra(avl_small& other, AVL_SET_OP op);
+};
+
+
+/*   ***   Constructors   ***   */
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+avl_small<T, N, Comp, Stats, Balance>::avl_small()
+        : avl_small(Comp()){
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+avl_small<T, N, Comp, Stats, Balance>::avl_small(const Comp& comp)
+        : avl_ebo<Comp, 0>(comp){
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+avl_small<T, N, Comp, Stats, Balance>::avl_small(std::vector<T> elements, bool sorted)
+        : avl_small(std::move(elements), Comp(), sorted){
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+avl_small<T, N, Comp, Stats, Balance>::avl_small(std::vector<T> elements, const Comp& comp, bool sorted)
+        : avl_small(comp){
+
+    if(!sorted)
+        std::sort(elements.begin(), elements.end(), avl_less_than<T, Comp>(keyComp()));
+
+    // the C'tor of avl checks the bigger ones:
+    if(elements.size() <= N){
+
+        for(size_t i = 1; i < elements.size(); i++)
+            if(!less(elements[i - 1], elements[i]))
+                throw non_unique_key<T>(elements[i]);
+    }
+
+    assignSorted(elements);
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+avl_small<T, N, Comp, Stats, Balance>::avl_small(T* elements, size_t arr_size, bool sorted)
+        : avl_small(std::vector<T>(elements, elements + arr_size), Comp(), sorted){
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+avl_small<T, N, Comp, Stats, Balance>::avl_small(T* elements, size_t arr_size, const Comp& comp, bool sorted)
+        : avl_small(std::vector<T>(elements, elements + arr_size), comp, sorted){
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+Comp
+avl_small<T, N, Comp, Stats, Balance>::key_comp() const{
+    return keyComp();
+}
+
+
+/*   ***   Operations   ***   */
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::insert(T element){
+
+    if(!try_insert(element).second)
+        throw key_already_exists<T>(element);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::remove(const T element){
+
+    if(!try_remove(element))
+        throw key_not_exist<T>(element);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+bool
+avl_small<T, N, Comp, Stats, Balance>::contains(const T& element) const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->contains(element);
+
+    const inline_keys& small = std::get<inline_keys>(store);
+
+    return foundAt(small, lowerBound(small, element), element);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+size_t
+avl_small<T, N, Comp, Stats, Balance>::rank(const T& key) const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->rank(key);
+
+    const inline_keys& small = std::get<inline_keys>(store);
+    size_t pos = lowerBound(small, key);
+
+    if(!foundAt(small, pos, key))
+        throw key_not_exist<T>(key);
+
+    return pos + 1;
+}
+
+
+/* Like avl::select, 'index' is 1-based */
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+const T&
+avl_small<T, N, Comp, Stats, Balance>::select(size_t index) const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->select(index);
+
+    const inline_keys& small = std::get<inline_keys>(store);
+
+    if(small.count == 0)
+        throw tree_is_empty();
+
+    if(index < 1)
+        return small.keys[0];
+
+    return small.keys[std::min(index, small.count) - 1];
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+std::vector<T>
+avl_small<T, N, Comp, Stats, Balance>::select_many(const std::vector<size_t>& sorted_indices) const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->select_many(sorted_indices);
+
+    std::vector<T> ret_val;
+    ret_val.reserve(sorted_indices.size());
+
+    for(size_t index : sorted_indices)
+        ret_val.push_back(select(index));
+
+    return ret_val;
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+std::vector<T>
+avl_small<T, N, Comp, Stats, Balance>::quantiles(size_t k) const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->quantiles(k);
+
+    size_t count = std::get<inline_keys>(store).count;
+
+    if(count == 0)
+        throw tree_is_empty();
+
+    if(k == 0)
+        k = 1;
+
+    // Nearest-rank cut points, as avl::quantiles:
+    std::vector<size_t> indices(k + 1);
+
+    for(size_t i = 0; i <= k; i++)
+        indices[i] = 1 + (i * (count - 1)) / k;
+
+    return select_many(indices);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+std::vector<size_t>
+avl_small<T, N, Comp, Stats, Balance>::rank_many(const std::vector<T>& sorted_keys) const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->rank_many(sorted_keys);
+
+    std::vector<size_t> ret_val;
+    ret_val.reserve(sorted_keys.size());
+
+    for(const T& key : sorted_keys)
+        ret_val.push_back(rank(key));
+
+    return ret_val;
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+T&
+avl_small<T, N, Comp, Stats, Balance>::getRef(const T& key){
+
+    // Like avl::getRef, don't change what the comparison of the keys depends on
+    if(tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->getRef(key);
+
+    inline_keys& small = std::get<inline_keys>(store);
+    size_t pos = lowerBound(small, key);
+
+    if(!foundAt(small, pos, key))
+        throw key_not_exist<T>(key);
+
+    return small.keys[pos];
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+const T&
+avl_small<T, N, Comp, Stats, Balance>::getMin() const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->getMin();
+
+    return select(1);
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+const T&
+avl_small<T, N, Comp, Stats, Balance>::getMax() const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->getMax();
+
+    return select(N);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+T
+avl_small<T, N, Comp, Stats, Balance>::popMin(){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store)){
+
+        T popped = tree->popMin();
+        fitInline();
+
+        return popped;
+    }
+
+    inline_keys& small = std::get<inline_keys>(store);
+
+    if(small.count == 0)
+        throw tree_is_empty();
+
+    T popped = std::move(small.keys[0]);
+    eraseInline(small, 0, 1);
+
+    return popped;
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+T
+avl_small<T, N, Comp, Stats, Balance>::popMax(){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store)){
+
+        T popped = tree->popMax();
+        fitInline();
+
+        return popped;
+    }
+
+    inline_keys& small = std::get<inline_keys>(store);
+
+    if(small.count == 0)
+        throw tree_is_empty();
+
+    return std::move(small.keys[--small.count]);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+size_t
+avl_small<T, N, Comp, Stats, Balance>::size() const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->size();
+
+    return std::get<inline_keys>(store).count;
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+bool
+avl_small<T, N, Comp, Stats, Balance>::empty() const{
+    return size() == 0;
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+std::vector<T>
+avl_small<T, N, Comp, Stats, Balance>::getAll() const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->getAll();
+
+    const inline_keys& small = std::get<inline_keys>(store);
+
+    return std::vector<T>(small.keys, small.keys + small.count);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+bool
+avl_small<T, N, Comp, Stats, Balance>::is_inline() const{
+    return std::holds_alternative<inline_keys>(store);
+}
+
+
+/*   ***   Bounded insert   ***   */
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+bool
+avl_small<T, N, Comp, Stats, Balance>::offer(T element, size_t capacity, AVL_EVICT evict){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store)){
+
+        bool inserted = tree->offer(element, capacity, evict);
+        fitInline();
+
+        return inserted;
+    }
+
+    if(capacity == 0)
+        return false;
+
+    bool evict_max = (evict == EVICT_MAX);
+
+    // A full set rejects what it would evict right away (and the equal key):
+    if(size() >= capacity){
+
+        if(evict_max ? !less(element, getMax()) : !less(getMin(), element))
+            return false;
+    }
+
+    if(!try_insert(element).second)
+        return false;
+
+    if(size() > capacity)
+        evict_max ? popMax() : popMin();
+
+    return true;
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+size_t
+avl_small<T, N, Comp, Stats, Balance>::shrink_to(size_t capacity, AVL_EVICT evict){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store)){
+
+        size_t evicted = tree->shrink_to(capacity, evict);
+        fitInline();
+
+        return evicted;
+    }
+
+    inline_keys& small = std::get<inline_keys>(store);
+
+    if(small.count <= capacity)
+        return 0;
+
+    if(evict == EVICT_MAX)
+        return eraseInline(small, capacity, small.count);
+
+    return eraseInline(small, 0, small.count - capacity);
+}
+
+
+/*   ***   Memory layout & Instrumentation   ***   */
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::compact(AVL_LAYOUT layout){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store))
+        tree->compact(layout);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+avl_stats_snapshot
+avl_small<T, N, Comp, Stats, Balance>::stats() const{
+
+    avl_stats_snapshot snap;
+
+    // The tree is inside this object, so its own size is counted once:
+    if(const tree_type* tree = std::get_if<tree_type>(&store)){
+
+        snap = tree->stats();
+        snap.total_bytes -= sizeof(tree_type);
+    }
+
+    avl_stats_snapshot inline_snap;
+    statsPolicy().fill(inline_snap);
+
+    snap.comparisons += inline_snap.comparisons;
+    snap.total_bytes += sizeof(*this);
+
+    return snap;
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::resetStats(){
+
+    this->avl_ebo<Stats, 1>::get().reset();
+
+    if(tree_type* tree = std::get_if<tree_type>(&store))
+        tree->resetStats();
+}
+
+
+/*   ***   iterator functions   ***   */
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+typename avl_small<T, N, Comp, Stats, Balance>::iterator
+avl_small<T, N, Comp, Stats, Balance>::begin(){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store))
+        return iterator(tree->begin());
+
+    inline_keys& small = std::get<inline_keys>(store);
+
+    return small.count ? iterator(small.keys, small.keys + small.count) : end();
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+typename avl_small<T, N, Comp, Stats, Balance>::iterator
+avl_small<T, N, Comp, Stats, Balance>::end(){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store))
+        return iterator(tree->end());
+
+    return iterator();
+}
+
+
+/*   ***   Hinted insert   ***   */
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+typename avl_small<T, N, Comp, Stats, Balance>::iterator
+avl_small<T, N, Comp, Stats, Balance>::insert(iterator hint, T element){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store))
+        return iterator(tree->insert(hint.it, element));
+
+    auto result = try_insert(element);
+
+    if(!result.second)
+        throw key_already_exists<T>(element);
+
+    return result.first;
+}
+
+
+/*   ***   Bulk removal   ***   */
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+size_t
+avl_small<T, N, Comp, Stats, Balance>::erase(iterator first, iterator last){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store)){
+
+        size_t removed = tree->erase(first.it, last.it);
+        fitInline();
+
+        return removed;
+    }
+
+    if(first == last)
+        return 0;
+
+    inline_keys& small = std::get<inline_keys>(store);
+    size_t to = last.key ? size_t(last.key - small.keys) : small.count;
+
+    return eraseInline(small, size_t(first.key - small.keys), to);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+size_t
+avl_small<T, N, Comp, Stats, Balance>::erase_range(const T from, const T to){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store)){
+
+        size_t removed = tree->erase_range(from, to);
+        fitInline();
+
+        return removed;
+    }
+
+    if(!less(from, to))
+        return 0;
+
+    inline_keys& small = std::get<inline_keys>(store);
+
+    return eraseInline(small, lowerBound(small, from), lowerBound(small, to));
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+template <typename Pred>
+size_t
+avl_small<T, N, Comp, Stats, Balance>::erase_if(Pred pred){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store)){
+
+        size_t removed = tree->erase_if(pred);
+        fitInline();
+
+        return removed;
+    }
+
+    inline_keys& small = std::get<inline_keys>(store);
+    T* kept_end = std::remove_if(small.keys, small.keys + small.count,
+                                 [&pred](const T& key){ return pred(key); });
+
+    size_t removed = (small.keys + small.count) - kept_end;
+    small.count -= removed;
+
+    return removed;
+}
+
+
+/*   ***   Set algebra   ***   */
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::set_union(const avl_small& other){
+
+    avl_small copy(other);
+    setAlgebra(copy, SET_UNION);
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::set_union(avl_small&& other){
+    setAlgebra(other, SET_UNION);
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::set_intersection(const avl_small& other){
+
+    avl_small copy(other);
+    setAlgebra(copy, SET_INTERSECTION);
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::set_intersection(avl_small&& other){
+    setAlgebra(other, SET_INTERSECTION);
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::set_difference(const avl_small& other){
+
+    avl_small copy(other);
+    setAlgebra(copy, SET_DIFFERENCE);
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::set_difference(avl_small&& other){
+    setAlgebra(other, SET_DIFFERENCE);
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::symmetric_difference(const avl_small& other){
+
+    avl_small copy(other);
+    setAlgebra(copy, SET_SYMMETRIC_DIFFERENCE);
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::symmetric_difference(avl_small&& other){
+    setAlgebra(other, SET_SYMMETRIC_DIFFERENCE);
+}
+
+
+/*   ***   Non-throwing lookup & update   ***   */
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+std::pair<typename avl_small<T, N, Comp, Stats, Balance>::iterator, bool>
+avl_small<T, N, Comp, Stats, Balance>::try_insert(T element){
+
+    if(inline_keys* small = std::get_if<inline_keys>(&store)){
+
+        size_t pos = lowerBound(*small, element);
+
+        if(foundAt(*small, pos, element))
+            return std::make_pair(iterator(small->keys + pos, small->keys + small->count), false);
+
+        if(small->count < N){
+
+            std::move_backward(small->keys + pos, small->keys + small->count,
+                               small->keys + small->count + 1);
+            small->keys[pos] = element;
+            small->count++;
+
+            return std::make_pair(iterator(small->keys + pos, small->keys + small->count), true);
+        }
+
+        toTree();
+    }
+
+    auto result = std::get<tree_type>(store).try_insert(element);
+
+    return std::make_pair(iterator(result.first), result.second);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+bool
+avl_small<T, N, Comp, Stats, Balance>::try_remove(const T& element){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store)){
+
+        if(!tree->try_remove(element))
+            return false;
+
+        fitInline();
+        return true;
+    }
+
+    inline_keys& small = std::get<inline_keys>(store);
+    size_t pos = lowerBound(small, element);
+
+    if(!foundAt(small, pos, element))
+        return false;
+
+    eraseInline(small, pos, pos + 1);
+
+    return true;
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+typename avl_small<T, N, Comp, Stats, Balance>::iterator
+avl_small<T, N, Comp, Stats, Balance>::find(const T& key) const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return iterator(tree->find(key));
+
+    const inline_keys& small = std::get<inline_keys>(store);
+    size_t pos = lowerBound(small, key);
+
+    if(!foundAt(small, pos, key))
+        return iterator();
+
+    return iterator(small.keys + pos, small.keys + small.count);
+}
+
+
+/*   ***   Tree Traversals   ***   */
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+template <typename Functor>
+void
+avl_small<T, N, Comp, Stats, Balance>::inorder(Functor& func){
+
+    if(tree_type* tree = std::get_if<tree_type>(&store)){
+
+        tree->inorder(func);
+        return;
+    }
+
+    inline_keys& small = std::get<inline_keys>(store);
+
+    for(size_t i = 0; i < small.count; i++)
+        func(small.keys[i]);
+}
+
+
+/*   ***   Early-exit scans   ***   */
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+template <typename Visitor>
+size_t
+avl_small<T, N, Comp, Stats, Balance>::scan(const T& start, Visitor visitor) const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->scan(start, visitor);
+
+    const inline_keys& small = std::get<inline_keys>(store);
+    size_t visited = 0;
+
+    for(size_t i = lowerBound(small, start); i < small.count; i++){
+
+        visited++;
+
+        if(visitor(small.keys[i]) == VISIT_STOP)
+            break;
+    }
+
+    return visited;
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+template <typename Visitor>
+size_t
+avl_small<T, N, Comp, Stats, Balance>::scan(Visitor visitor) const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store))
+        return tree->scan(visitor);
+
+    const inline_keys& small = std::get<inline_keys>(store);
+    size_t visited = 0;
+
+    for(size_t i = 0; i < small.count; i++){
+
+        visited++;
+
+        if(visitor(small.keys[i]) == VISIT_STOP)
+            break;
+    }
+
+    return visited;
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+template <typename Functor>
+void
+avl_small<T, N, Comp, Stats, Balance>::constInorder(Functor& func) const{
+
+    if(const tree_type* tree = std::get_if<tree_type>(&store)){
+
+        tree->constInorder(func);
+        return;
+    }
+
+    const inline_keys& small = std::get<inline_keys>(store);
+
+    for(size_t i = 0; i < small.count; i++)
+        func(small.keys[i]);
+}
+
+
+/*   ***   Private methods   ***   */
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+bool
+avl_small<T, N, Comp, Stats, Balance>::less(const T& k1, const T& k2) const{
+
+    statsPolicy().onCompare();
+    return avl_comp_traits<T, Comp>::less(keyComp(), k1, k2);
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+const Comp&
+avl_small<T, N, Comp, Stats, Balance>::keyComp() const{
+    return this->avl_ebo<Comp, 0>::get();
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+const Stats&
+avl_small<T, N, Comp, Stats, Balance>::statsPolicy() const{
+    return this->avl_ebo<Stats, 1>::get();
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+size_t
+avl_small<T, N, Comp, Stats, Balance>::lowerBound(const inline_keys& small, const T& key) const{
+
+    // No early exit and no branch, so the loop is vectorized:
+    size_t pos = 0;
+
+    for(size_t i = 0; i < small.count; i++)
+        pos += less(small.keys[i], key);
+
+    return pos;
+}
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+bool
+avl_small<T, N, Comp, Stats, Balance>::foundAt(const inline_keys& small, size_t pos, const T& key) const{
+    return pos < small.count && !less(key, small.keys[pos]);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+size_t
+avl_small<T, N, Comp, Stats, Balance>::eraseInline(inline_keys& small, size_t from, size_t to){
+
+    std::move(small.keys + to, small.keys + small.count, small.keys + from);
+    small.count -= to - from;
+
+    return to - from;
+}
+
+
+/*
+ *  The keys are sorted & unique, so the tree is built in O(N).
+ *  Each new representation is built aside and then moved into 'store' (avl & the array move
+ *  without throwing), so a throw keeps the old one: 'store' is never valueless_by_exception.
+ */
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::toTree(){
+
+    const inline_keys& small = std::get<inline_keys>(store);
+    tree_type tree(std::vector<T>(small.keys, small.keys + small.count), keyComp(), true);
+
+    store = std::move(tree);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::toInline(){
+
+    std::vector<T> elements = std::get<tree_type>(store).getAll();
+    inline_keys small;
+
+    std::move(elements.begin(), elements.end(), small.keys);
+    small.count = elements.size();
+
+    store = std::move(small);
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::fitInline(){
+
+    if(std::get<tree_type>(store).size() <= N / 2)
+        toInline();
+}
+
+
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::assignSorted(std::vector<T>& sorted_elem){
+
+    if(sorted_elem.size() > N){
+
+        tree_type tree(std::move(sorted_elem), keyComp(), true);
+        store = std::move(tree);
+        return;
+    }
+
+    inline_keys small;
+
+    std::move(sorted_elem.begin(), sorted_elem.end(), small.keys);
+    small.count = sorted_elem.size();
+
+    store = std::move(small);
+}
+
+
+/*
+ *  Two inline sets are merged as sorted arrays, in O(N).
+ *  Otherwise both go through trees: the inline one is built into a tree first (O(N)),
+ *  and the tree's split & join algebra (see avl) does the rest.
+ */
+template <typename T, size_t N, typename Comp, typename Stats, typename Balance>
+void
+avl_small<T, N, Comp, Stats, Balance>::setAlgebra(avl_small& other, AVL_SET_OP op){
+
+    // a.set_union(std::move(a)):
+    if(&other == this){
+
+        if(op == SET_DIFFERENCE || op == SET_SYMMETRIC_DIFFERENCE)
+            store = inline_keys();
+
+        return;
+    }
+
+    if(is_inline() && other.is_inline()){
+
+        const inline_keys& mine = std::get<inline_keys>(store);
+        const inline_keys& theirs = std::get<inline_keys>(other.store);
+
+        const T *first1 = mine.keys, *last1 = mine.keys + mine.count;
+        const T *first2 = theirs.keys, *last2 = theirs.keys + theirs.count;
+
+        std::vector<T> result;
+        avl_less_than<T, Comp> by_comp(keyComp());
+        auto out = std::back_inserter(result);
+
+        switch(op){
+
+        case SET_UNION:
+            std::set_union(first1, last1, first2, last2, out, by_comp);
+            break;
+
+        case SET_INTERSECTION:
+            std::set_intersection(first1, last1, first2, last2, out, by_comp);
+            break;
+
+        case SET_DIFFERENCE:
+            std::set_difference(first1, last1, first2, last2, out, by_comp);
+            break;
+
+        case SET_SYMMETRIC_DIFFERENCE:
+            std::set_symmetric_difference(first1, last1, first2, last2, out, by_comp);
+            break;
+        }
+
+        assignSorted(result);
+        other.store = inline_keys();
+        return;
+    }
+
+    if(is_inline())
+        toTree();
+
+    if(other.is_inline())
+        other.toTree();
+
+    tree_type& mine = std::get<tree_type>(store);
+    tree_type&& theirs = std::move(std::get<tree_type>(other.store));
+
+    switch(op){
+
+    case SET_UNION:
+        mine.set_union(std::move(theirs));
+        break;
+
+    case SET_INTERSECTION:
+        mine.set_intersection(std::move(theirs));
+        break;
+
+    case SET_DIFFERENCE:
+        mine.set_difference(std::move(theirs));
+        break;
+
+    case SET_SYMMETRIC_DIFFERENCE:
+        mine.symmetric_difference(std::move(theirs));
+        break;
+    }
+
+    other.store = inline_keys();
+    fitInline();
+}
+
+
+#endif /* AVL_SMALL_H_ */
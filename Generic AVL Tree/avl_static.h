@@ -0,0 +1,338 @@
+#ifndef AVL_STATIC_H_
+#define AVL_STATIC_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "avl_utils.h"
+
+
+/*
+ *  Read-only ordered set, built at compile time.
+ *
+ *  The keys are sorted by the constexpr C'tor and laid out in BFS (Eytzinger) order:
+ *  the sons of keys[k - 1] are keys[2k - 1] and keys[2k]. No pointers, no weights:
+ *  the size of any subtree follows from N, so rank & select stay O(log(N)).
+ *  A 'static constexpr' table costs no startup time and no heap, and lands in read-only data:
+ *
+ *      static constexpr static_avl<uint32_t, 3> magics({0x89504E47, 0x25504446, 0xFFD8FFE0});
+ *      static_assert(magics.contains(0x25504446));
+ *
+ *  A duplicate key throws non_unique_key, which is a compile error in a constant expression.
+ */
+
+template <typename T, size_t N, typename Comp = std::less<T>>
+class static_avl : private avl_ebo<Comp, 0> {
+    static_assert(N > 0, "static_avl needs at least one key");
+
+    T keys[N];          // BFS order
+    int height;         // number of levels
+
+public:
+// Constractors:
+    constexpr explicit static_avl(const T (&elements)[N], const Comp& comp = Comp());
+
+// Operations:
+    constexpr bool contains(const T& key) const;
+
+    /* Like avl::rank & avl::select: 1-based, and select() clamps to the min or the max */
+    constexpr size_t rank(const T& key) const;
+    constexpr const T& select(size_t index) const;
+
+    constexpr const T& getMin() const;
+    constexpr const T& getMax() const;
+    constexpr size_t size() const;
+    std::vector<T> getAll() const;
+
+// Const Tree Traversals (for read-only use):
+    template <typename Functor>
+    constexpr void constInorder(Functor& func) const;
+
+private:
+    constexpr bool less(const T& k1, const T& k2) const;
+
+    /* BFS number (1-based) of the least key not less than 'key', 0 if there is none */
+    constexpr size_t lowerBound(const T& key) const;
+    constexpr size_t subtreeSize(size_t k) const;
+
+// C'tor Auxiliary Functions:
+    constexpr void sortKeys(T* sorted) const;
+    constexpr void siftDown(T* heap, size_t root, size_t heap_size) const;
+    constexpr size_t fill(const T* sorted, size_t next, size_t k);
+
+    template <typename Functor>
+    constexpr void inorderAux(Functor& func, size_t k) const;
+};
+
+
+template <typename T, size_t N>
+static_avl(const T (&)[N]) -> static_avl<T, N>;
+
+
+/*   ***   Constructors   ***   */
+
+template <typename T, size_t N, typename Comp>
+constexpr static_avl<T, N, Comp>::static_avl(const T (&elements)[N], const Comp& comp)
+        : avl_ebo<Comp, 0>(comp), keys(), height(0){
+
+    T sorted[N] = {};
+
+    for(size_t i = 0; i < N; i++)
+        sorted[i] = elements[i];
+
+    sortKeys(sorted);
+
+    for(size_t i = 1; i < N; i++){
+
+        if(!less(sorted[i - 1], sorted[i]))
+            throw non_unique_key<T>(sorted[i]);
+    }
+
+    while((size_t(1) << height) <= N)
+        height++;
+
+    fill(sorted, 0, 1);
+}
+
+
+/*   ***   Operations   ***   */
+
+template <typename T, size_t N, typename Comp>
+constexpr bool
+static_avl<T, N, Comp>::contains(const T& key) const{
+
+    size_t k = lowerBound(key);
+
+    return k != 0 && !less(key, keys[k - 1]);
+}
+
+
+/* The keys before keys[k - 1] in order: its left subtree, and each left brother on the way up */
+template <typename T, size_t N, typename Comp>
+constexpr size_t
+static_avl<T, N, Comp>::rank(const T& key) const{
+
+    size_t k = lowerBound(key);
+
+    if(k == 0 || less(key, keys[k - 1]))
+        throw key_not_exist<T>(key);
+
+    size_t rank = subtreeSize(2 * k) + 1;
+
+    for(; k > 1; k /= 2){
+
+        if(k % 2 == 1)
+            rank += subtreeSize(k - 1) + 1;
+    }
+
+    return rank;
+}
+
+
+template <typename T, size_t N, typename Comp>
+constexpr const T&
+static_avl<T, N, Comp>::select(size_t index) const{
+
+    if(index == 0)
+        return getMin();
+
+    if(index >= N)
+        return getMax();
+
+    size_t k = 1;
+
+    while(true){
+
+        size_t left = subtreeSize(2 * k);
+
+        if(index <= left){
+            k = 2 * k;
+            continue;
+        }
+
+        if(index == left + 1)
+            return keys[k - 1];
+
+        index -= left + 1;
+        k = 2 * k + 1;
+    }
+}
+
+
+template <typename T, size_t N, typename Comp>
+constexpr const T&
+static_avl<T, N, Comp>::getMin() const{
+
+    size_t k = 1;
+
+    while(2 * k <= N)
+        k = 2 * k;
+
+    return keys[k - 1];
+}
+
+template <typename T, size_t N, typename Comp>
+constexpr const T&
+static_avl<T, N, Comp>::getMax() const{
+
+    size_t k = 1;
+
+    while(2 * k + 1 <= N)
+        k = 2 * k + 1;
+
+    return keys[k - 1];
+}
+
+template <typename T, size_t N, typename Comp>
+constexpr size_t
+static_avl<T, N, Comp>::size() const{
+    return N;
+}
+
+
+template <typename T, size_t N, typename Comp>
+std::vector<T>
+static_avl<T, N, Comp>::getAll() const{
+
+    GetFunctor<T> functor;
+    constInorder(functor);
+
+    return functor.vec;
+}
+
+
+template <typename T, size_t N, typename Comp>
+template <typename Functor>
+constexpr void
+static_avl<T, N, Comp>::constInorder(Functor& func) const{
+    inorderAux(func, 1);
+}
+
+
+/*   ***   Private methods   ***   */
+
+template <typename T, size_t N, typename Comp>
+constexpr bool
+static_avl<T, N, Comp>::less(const T& k1, const T& k2) const{
+    return avl_comp_traits<T, Comp>::less(this->get(), k1, k2);
+}
+
+
+/*
+ *  Branch-free descent: a right turn appends a 1 bit to k, a left turn a 0 bit.
+ *  The answer is the last node where the descent turned left,
+ *  so the trailing 1 bits and the 0 bit before them are dropped.
+ */
+template <typename T, size_t N, typename Comp>
+constexpr size_t
+static_avl<T, N, Comp>::lowerBound(const T& key) const{
+
+    size_t k = 1;
+
+    while(k <= N)
+        k = 2 * k + less(keys[k - 1], key);
+
+    while(k % 2 == 1)
+        k /= 2;
+
+    return k / 2;
+}
+
+
+/*
+ *  Every level of the subtree of k is full, except maybe the last level of the tree.
+ *  The last level of the subtree is the BFS range [k << h, (k + 1) << h), cut at N.
+ */
+template <typename T, size_t N, typename Comp>
+constexpr size_t
+static_avl<T, N, Comp>::subtreeSize(size_t k) const{
+
+    if(k > N)
+        return 0;
+
+    int depth = 0;
+    for(size_t i = k; i > 1; i /= 2)
+        depth++;
+
+    int h = height - 1 - depth;
+    size_t first = k << h;
+    size_t last_level = 0;
+
+    if(first <= N)
+        last_level = (N - first + 1 < (size_t(1) << h)) ? N - first + 1 : (size_t(1) << h);
+
+    return (size_t(1) << h) - 1 + last_level;
+}
+
+
+/* Heapsort: in place, O(N*log(N)) steps, and constexpr unlike std::sort before C++20 */
+template <typename T, size_t N, typename Comp>
+constexpr void
+static_avl<T, N, Comp>::sortKeys(T* sorted) const{
+
+    for(size_t root = N / 2; root > 0; root--)
+        siftDown(sorted, root - 1, N);
+
+    for(size_t heap_size = N - 1; heap_size > 0; heap_size--){
+
+        T max = sorted[0];
+        sorted[0] = sorted[heap_size];
+        sorted[heap_size] = max;
+
+        siftDown(sorted, 0, heap_size);
+    }
+}
+
+template <typename T, size_t N, typename Comp>
+constexpr void
+static_avl<T, N, Comp>::siftDown(T* heap, size_t root, size_t heap_size) const{
+
+    while(2 * root + 1 < heap_size){
+
+        size_t son = 2 * root + 1;
+
+        if(son + 1 < heap_size && less(heap[son], heap[son + 1]))
+            son++;
+
+        if(!less(heap[root], heap[son]))
+            return;
+
+        T temp = heap[root];
+        heap[root] = heap[son];
+        heap[son] = temp;
+
+        root = son;
+    }
+}
+
+
+/* In-order walk of the BFS layout. Returns the next index of 'sorted' */
+template <typename T, size_t N, typename Comp>
+constexpr size_t
+static_avl<T, N, Comp>::fill(const T* sorted, size_t next, size_t k){
+
+    if(k > N)
+        return next;
+
+    next = fill(sorted, next, 2 * k);
+    keys[k - 1] = sorted[next++];
+
+    return fill(sorted, next, 2 * k + 1);
+}
+
+
+template <typename T, size_t N, typename Comp>
+template <typename Functor>
+constexpr void
+static_avl<T, N, Comp>::inorderAux(Functor& func, size_t k) const{
+
+    if(k > N)
+        return;
+
+    inorderAux(func, 2 * k);
+    func(keys[k - 1]);
+    inorderAux(func, 2 * k + 1);
+}
+
+
+#endif /* AVL_STATIC_H_ */
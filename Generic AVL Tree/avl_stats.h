@@ -0,0 +1,104 @@
+#ifndef AVL_STATS_H_
+#define AVL_STATS_H_
+
+#include <cstddef>
+#include <vector>
+
+
+/*   ***   Snapshot returned by avl::stats()   ***   */
+
+struct avl_stats_snapshot {
+    size_t comparisons = 0;
+    size_t single_rotations = 0;
+    size_t double_rotations = 0;
+    size_t allocations = 0;
+    size_t frees = 0;
+
+    /* search_path[d] = number of lookups that visited d nodes */
+    std::vector<size_t> search_path;
+
+    size_t bytes_per_node = 0;
+    size_t total_bytes = 0;
+};
+
+
+/*
+ *  Stats policies.
+ *
+ *  avl<T, Comp, Stats> calls the hooks below from its hot paths.
+ *  The hooks are const because lookups are const; counters are mutable.
+ *
+ *  avl_no_stats is the default: every hook is an empty inline function
+ *  and the policy is stored as an empty base, so it costs nothing.
+ */
+
+class avl_no_stats {
+public:
+    void onCompare() const {}
+    void onRotation(bool /* is_double */) const {}
+    void onAlloc() const {}
+    void onFree(size_t /* count */) const {}
+    void onSearch(size_t /* path_length */) const {}
+
+    void fill(avl_stats_snapshot& /* snap */) const {}
+    void reset() {}
+};
+
+
+class avl_counting_stats {
+    mutable size_t comparisons = 0;
+    mutable size_t single_rotations = 0;
+    mutable size_t double_rotations = 0;
+    mutable size_t allocations = 0;
+    mutable size_t frees = 0;
+    mutable std::vector<size_t> search_path;
+
+public:
+    void onCompare() const {
+        comparisons++;
+    }
+
+    void onRotation(bool is_double) const {
+
+        if(is_double)
+            double_rotations++;
+        else
+            single_rotations++;
+    }
+
+    void onAlloc() const {
+        allocations++;
+    }
+
+    void onFree(size_t count) const {
+        frees += count;
+    }
+
+    void onSearch(size_t path_length) const {
+
+        if(search_path.size() <= path_length)
+            search_path.resize(path_length + 1, 0);
+
+        search_path[path_length]++;
+    }
+
+    void fill(avl_stats_snapshot& snap) const {
+
+        snap.comparisons = comparisons;
+        snap.single_rotations = single_rotations;
+        snap.double_rotations = double_rotations;
+        snap.allocations = allocations;
+        snap.frees = frees;
+        snap.search_path = search_path;
+    }
+
+    void reset() {
+
+        comparisons = single_rotations = double_rotations = 0;
+        allocations = frees = 0;
+        search_path.clear();
+    }
+};
+
+
+#endif /* AVL_STATS_H_ */
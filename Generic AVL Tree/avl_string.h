@@ -0,0 +1,127 @@
+#ifndef AVL_STRING_H_
+#define AVL_STRING_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/*
+ *  String keys with an inline prefix.
+ *
+ *  The first 8 bytes of the string are packed big-endian into 'prefix',
+ *  which lives in the node next to the string. Comparing two prefixes as integers
+ *  orders them like the bytes, so most comparisons on the search path end there
+ *  and never touch the string's heap buffer.
+ *
+ *  avl_prefixed_string owns its string.
+ *  avl_prefixed_view points into an avl_string_arena, which keeps the strings contiguous.
+ *
+ *  Use them with avl_prefixed_compare, a three-way comparator:
+ *      avl<avl_prefixed_string, avl_prefixed_compare> paths;
+ *      paths.insert(avl_prefixed_string("/var/log/syslog"));
+ */
+
+template <typename Str>
+struct avl_prefixed {
+    uint64_t prefix;
+    Str str;
+
+    avl_prefixed() : prefix(0), str(){}
+    avl_prefixed(Str s) : prefix(pack(s)), str(std::move(s)){}
+
+    std::string_view view() const{ return str; }
+
+    /* The first 8 bytes, big-endian, padded with zeros */
+    static uint64_t pack(std::string_view s){
+
+        uint64_t packed = 0;
+        size_t n = s.size() < 8 ? s.size() : 8;
+
+        for(size_t i = 0; i < n; i++)
+            packed |= uint64_t(static_cast<unsigned char>(s[i])) << (56 - 8 * i);
+
+        return packed;
+    }
+};
+
+using avl_prefixed_string = avl_prefixed<std::string>;
+using avl_prefixed_view = avl_prefixed<std::string_view>;
+
+
+struct avl_prefixed_compare {
+    using is_three_way = void;
+
+    template <typename Str1, typename Str2>
+    int operator()(const avl_prefixed<Str1>& k1, const avl_prefixed<Str2>& k2) const{
+
+        if(k1.prefix != k2.prefix)
+            return k1.prefix < k2.prefix ? -1 : 1;
+
+        // The bytes before 'common' are equal, the prefixes say so:
+        std::string_view s1 = k1.view(), s2 = k2.view();
+        size_t common = std::min<size_t>({8, s1.size(), s2.size()});
+
+        int cmp = s1.substr(common).compare(s2.substr(common));
+
+        return cmp < 0 ? -1 : (cmp > 0 ? 1 : 0);
+    }
+};
+
+
+/*
+ *  Append-only storage for the strings of avl_prefixed_view keys.
+ *  The strings are copied into blocks of 'block_size' bytes (a longer one gets its own block),
+ *  so the keys scanned together are close in memory. Nothing is freed before the arena,
+ *  which must outlive the trees that use it.
+ */
+class avl_string_arena {
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<std::unique_ptr<char[]>> large;     // strings longer than a block
+    size_t block_size;
+    size_t used;            // bytes used in the last block
+
+public:
+    explicit avl_string_arena(size_t block_size = 1 << 16)
+            : block_size(block_size), used(block_size){}
+
+    avl_string_arena(const avl_string_arena&) = delete;
+    avl_string_arena& operator=(const avl_string_arena&) = delete;
+
+    avl_prefixed_view make(std::string_view s){
+        return avl_prefixed_view(intern(s));
+    }
+
+    std::string_view intern(std::string_view s){
+
+        if(s.empty())
+            return std::string_view();
+
+        if(s.size() > block_size){
+
+            large.push_back(std::make_unique<char[]>(s.size()));
+            std::memcpy(large.back().get(), s.data(), s.size());
+
+            return std::string_view(large.back().get(), s.size());
+        }
+
+        if(used + s.size() > block_size){
+
+            blocks.push_back(std::make_unique<char[]>(block_size));
+            used = 0;
+        }
+
+        char* dest = blocks.back().get() + used;
+        std::memcpy(dest, s.data(), s.size());
+        used += s.size();
+
+        return std::string_view(dest, s.size());
+    }
+};
+
+
+#endif /* AVL_STRING_H_ */
@@ -0,0 +1,457 @@
+/*
+ *  Behaviour tests of the tree variants, against std::set & std::map.
+ *
+ *  Every container gets the same random mix of inserts & removes on a small key range
+ *  (so both hit existing keys often), next to a std::set model. After each operation the
+ *  answers must agree, and every few hundred operations the whole contents, size, rank &
+ *  select are compared. The set algebra of avl & avl_small runs against the std algorithms.
+ *  A failure prints the container and the operation, the exit status is the number of failures (capped).
+ *
+ *  Build & run (no -DNDEBUG needed, the checks are not asserts):
+ *      g++ -std=c++17 -O2 -pthread avl_test.cpp -o avl_test
+ *      ./avl_test
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "avl_compressed.h"
+#include "avl_hashed.h"
+#include "avl_map.h"
+#include "avl_sharded.h"
+#include "avl_small.h"
+#include "avl_static.h"
+#include "avl_string.h"
+
+
+static int failures = 0;
+
+static void check(bool ok, const char* name, const char* what, long long key = 0){
+
+    if(ok)
+        return;
+
+    failures++;
+    std::printf("FAIL %s: %s (%lld)\n", name, what, key);
+}
+
+
+/* try_insert returns a bool, or (iterator, bool) like std::set::insert */
+static bool inserted(bool ret_val){ return ret_val; }
+
+template <typename Iter>
+static bool inserted(const std::pair<Iter, bool>& ret_val){ return ret_val.second; }
+
+
+/*   ***   The same checks for every set   ***   */
+
+template <typename Set, typename T>
+void checkContents(Set& set, const std::set<T>& model, const char* name){
+
+    check(set.size() == model.size(), name, "size", (long long)set.size());
+
+    std::vector<T> all = set.getAll();
+    check(all == std::vector<T>(model.begin(), model.end()), name, "getAll");
+
+    std::vector<T> walked;
+    for(auto it = set.begin(); it != set.end(); ++it)
+        walked.push_back(*it);
+    check(walked == all, name, "iteration");
+
+    if(model.empty())
+        return;
+
+    // rank & select are 1-based
+    size_t step = model.size() / 7 + 1;
+    for(size_t i = 0; i < all.size(); i += step){
+        check(set.rank(all[i]) == i + 1, name, "rank", (long long)all[i]);
+        check(set.select(i + 1) == all[i], name, "select", (long long)i + 1);
+    }
+}
+
+template <typename Set, typename T>
+void randomOps(Set& set, const char* name, T range, int ops, unsigned seed){
+
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<T> key(-range, range);
+    std::set<T> model;
+
+    for(int op = 0; op < ops; op++){
+
+        T k = key(gen);
+
+        switch(gen() % 4){
+            case 0:
+            case 1:
+                check(inserted(set.try_insert(k)) == model.insert(k).second, name, "try_insert", k);
+                break;
+            case 2:
+                check(set.try_remove(k) == (model.erase(k) == 1), name, "try_remove", k);
+                break;
+            default:
+                check(set.contains(k) == (model.count(k) == 1), name, "contains", k);
+        }
+
+        if(op % 500 == 0)
+            checkContents(set, model, name);
+    }
+
+    checkContents(set, model, name);
+
+    // Down to empty, then up again
+    for(T k : std::vector<T>(model.begin(), model.end()))
+        check(set.try_remove(k), name, "drain", k);
+    model.clear();
+    checkContents(set, model, name);
+
+    for(T k = 0; k < 100; k++)
+        check(inserted(set.try_insert(k)) == model.insert(k).second, name, "refill", k);
+    checkContents(set, model, name);
+}
+
+
+/*   ***   avl, avl_small & set algebra   ***   */
+
+template <typename Set>
+void testMinMax(Set& set, const char* name){
+
+    std::mt19937 gen(7);
+    std::set<int> model;
+    for(int k : set.getAll())
+        model.insert(k);
+
+    for(int op = 0; op < 3000; op++){
+
+        int k = int(gen() % 200);
+
+        if(gen() % 3)
+            set.try_insert(k), model.insert(k);
+        else
+            set.try_remove(k), model.erase(k);
+
+        if(!model.empty()){
+            check(set.getMin() == *model.begin(), name, "getMin", k);
+            check(set.getMax() == *model.rbegin(), name, "getMax", k);
+        }
+    }
+}
+
+template <typename Set>
+void testPop(Set& set, const char* name){
+
+    std::set<int> model;
+    for(int k : set.getAll())
+        model.insert(k);
+
+    while(!model.empty()){
+        check(set.popMin() == *model.begin(), name, "popMin");
+        model.erase(model.begin());
+
+        if(model.empty())
+            break;
+
+        check(set.popMax() == *model.rbegin(), name, "popMax");
+        model.erase(std::prev(model.end()));
+    }
+    check(set.empty(), name, "popped to empty");
+}
+
+template <typename Set>
+void testErase(Set& set, const char* name){
+
+    std::set<int> model;
+    for(int k = 0; k < 300; k++)
+        set.insert(k), model.insert(k);
+
+    check(set.erase_range(50, 120) == 70, name, "erase_range");
+    model.erase(model.lower_bound(50), model.lower_bound(120));
+
+    check(set.erase_if([](int k){ return k % 3 == 0; }) == 77, name, "erase_if");
+    for(auto it = model.begin(); it != model.end();)
+        it = *it % 3 == 0 ? model.erase(it) : std::next(it);
+
+    checkContents(set, model, name);
+}
+
+template <typename Set>
+void testSetAlgebra(const char* name){
+
+    std::mt19937 gen(11);
+
+    for(int round = 0; round < 40; round++){
+
+        // Sizes from empty to a few hundred, ranges from disjoint to equal
+        std::set<int> a, b;
+        int size_a = int(gen() % 300), size_b = int(gen() % 300), offset = int(gen() % 400);
+        for(int i = 0; i < size_a; i++) a.insert(int(gen() % 400));
+        for(int i = 0; i < size_b; i++) b.insert(offset + int(gen() % 400));
+
+        std::vector<int> va(a.begin(), a.end()), vb(b.begin(), b.end()), expected;
+
+        const char* ops[] = {"set_union", "set_intersection", "set_difference", "symmetric_difference"};
+
+        for(int op = 0; op < 4; op++){
+
+            Set x(va, true), y(vb, true);
+            expected.clear();
+
+            switch(op){
+                case 0:
+                    x.set_union(y);
+                    std::set_union(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(expected));
+                    break;
+                case 1:
+                    x.set_intersection(std::move(y));
+                    std::set_intersection(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(expected));
+                    break;
+                case 2:
+                    x.set_difference(y);
+                    std::set_difference(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(expected));
+                    break;
+                default:
+                    x.symmetric_difference(std::move(y));
+                    std::set_symmetric_difference(va.begin(), va.end(), vb.begin(), vb.end(),
+                                                  std::back_inserter(expected));
+            }
+
+            checkContents(x, std::set<int>(expected.begin(), expected.end()), ops[op]);
+            check(x.getAll() == expected, name, ops[op], round);
+        }
+    }
+}
+
+
+/*   ***   avl_sharded   ***   */
+
+/* Disjoint key ranges per thread: the result is known however they interleave */
+void testShardedThreads(){
+
+    avl_sharded<int> set(64);
+    const int threads = 4, per_thread = 5000;
+    std::vector<std::thread> workers;
+
+    for(int t = 0; t < threads; t++){
+        workers.emplace_back([&set, t](){
+            for(int i = 0; i < per_thread; i++)
+                set.insert(t * per_thread + i);
+            for(int i = 0; i < per_thread; i += 2)
+                set.remove(t * per_thread + i);
+        });
+    }
+
+    for(std::thread& worker : workers)
+        worker.join();
+
+    std::set<int> model;
+    for(int k = 1; k < threads * per_thread; k += 2)
+        model.insert(k);
+
+    checkContents(set, model, "avl_sharded threads");
+}
+
+
+/*   ***   avl_map   ***   */
+
+void testMap(){
+
+    std::mt19937 gen(5);
+    avl_map<int, std::string> map;
+    std::map<int, std::string> model;
+
+    for(int op = 0; op < 20000; op++){
+
+        int k = int(gen() % 500);
+        std::string v = std::to_string(gen() % 1000);
+
+        switch(gen() % 5){
+            case 0:
+                check(map.insert_or_assign(k, v).second == model.insert_or_assign(k, v).second,
+                      "avl_map", "insert_or_assign", k);
+                break;
+            case 1:
+                check(map.try_emplace(k, v).second == model.try_emplace(k, v).second, "avl_map", "try_emplace", k);
+                break;
+            case 2:
+                map[k] += "x";
+                model[k] += "x";
+                break;
+            case 3:
+                check(map.try_remove(k) == (model.erase(k) == 1), "avl_map", "try_remove", k);
+                break;
+            default: {
+                const avl_map<int, std::string>& const_map = map;
+                auto it = const_map.find(k);
+                check((it != decltype(it)()) == (model.count(k) == 1), "avl_map", "find", k);
+                if(model.count(k))
+                    check(const_map.at(k) == model.at(k), "avl_map", "at", k);
+            }
+        }
+    }
+
+    std::map<int, std::string> walked;
+    for(auto it = map.begin(); it != map.end(); ++it)
+        walked.emplace(it.key(), it.value());
+    check(walked == model && map.size() == model.size(), "avl_map", "contents");
+
+    avl_map<int, std::string> copy;
+    copy = map;
+    map.remove(model.begin()->first);
+    check(copy.size() == model.size() && copy.at(model.begin()->first) == model.begin()->second,
+          "avl_map", "copy is independent");
+}
+
+
+/*   ***   String keys   ***   */
+
+/* Paths sharing long prefixes, so both the prefix & the string compare are exercised */
+static std::string randomPath(std::mt19937& gen){
+
+    const char* dirs[] = {"/var/log/", "/var/lib/", "/usr/lib/", "/u", ""};
+    std::string path = dirs[gen() % 5];
+
+    size_t length = gen() % 12;
+    for(size_t i = 0; i < length; i++)
+        path += char('a' + gen() % 3);
+
+    return path;
+}
+
+void testStrings(){
+
+    std::mt19937 gen(3);
+    avl<avl_prefixed_string, avl_prefixed_compare> owned;
+    avl<avl_prefixed_view, avl_prefixed_compare> viewed;
+    avl_string_arena arena(256);
+    std::set<std::string> model;
+
+    for(int op = 0; op < 20000; op++){
+
+        std::string path = randomPath(gen);
+
+        if(gen() % 3){
+            bool is_new = model.insert(path).second;
+            check(owned.try_insert(avl_prefixed_string(path)).second == is_new, "avl_prefixed_string", "try_insert");
+            check(viewed.try_insert(arena.make(path)).second == is_new, "avl_prefixed_view", "try_insert");
+        }
+        else{
+            bool was_in = model.erase(path) == 1;
+            check(owned.try_remove(avl_prefixed_string(path)) == was_in, "avl_prefixed_string", "try_remove");
+            check(viewed.try_remove(avl_prefixed_view(path)) == was_in, "avl_prefixed_view", "try_remove");
+        }
+    }
+
+    std::vector<std::string> walked_owned, walked_viewed;
+    for(auto it = owned.begin(); it != owned.end(); ++it)
+        walked_owned.emplace_back((*it).view());
+    for(auto it = viewed.begin(); it != viewed.end(); ++it)
+        walked_viewed.emplace_back((*it).view());
+
+    std::vector<std::string> expected(model.begin(), model.end());
+    check(walked_owned == expected, "avl_prefixed_string", "order");
+    check(walked_viewed == expected, "avl_prefixed_view", "order");
+}
+
+
+/*   ***   static_avl   ***   */
+
+constexpr int static_keys[] = {42, 7, 19, -3, 88, 0, 61, 25, 13, 70, -50, 33};
+constexpr static_avl<int, 12> static_set(static_keys);
+
+static_assert(static_set.contains(19) && !static_set.contains(20), "static_avl lookup at compile time");
+static_assert(static_set.getMin() == -50 && static_set.getMax() == 88, "static_avl min & max");
+static_assert(static_set.rank(19) == 6 && static_set.select(6) == 19, "static_avl rank & select");
+
+template <size_t N>
+void testStatic(unsigned seed){
+
+    std::mt19937 gen(seed);
+    int keys[N];
+    std::set<int> model;
+
+    // Distinct keys, in random order
+    while(model.size() < N)
+        model.insert(int(gen() % (4 * N)) - int(2 * N));
+    std::copy(model.begin(), model.end(), keys);
+    std::shuffle(keys, keys + N, gen);
+
+    static_avl<int, N> set(keys);
+    std::vector<int> sorted(model.begin(), model.end());
+
+    check(set.getAll() == sorted, "static_avl", "getAll", N);
+    check(set.getMin() == sorted.front() && set.getMax() == sorted.back(), "static_avl", "min & max", N);
+
+    for(size_t i = 0; i < N; i++){
+        check(set.rank(sorted[i]) == i + 1, "static_avl", "rank", sorted[i]);
+        check(set.select(i + 1) == sorted[i], "static_avl", "select", (long long)i + 1);
+    }
+
+    for(int k = -int(2 * N) - 1; k <= int(2 * N) + 1; k++)
+        check(set.contains(k) == (model.count(k) == 1), "static_avl", "contains", k);
+}
+
+
+int main(){
+
+    {
+        avl<int> set;
+        randomOps(set, "avl", 300, 20000, 1);
+        testMinMax(set, "avl");
+        testPop(set, "avl");
+        testErase(set, "avl");
+        testSetAlgebra<avl<int>>("avl");
+    }
+    {
+        // From inline keys to a tree & back, many times
+        avl_small<int, 8> small;
+        randomOps(small, "avl_small", 6, 20000, 2);
+        avl_small<int, 8> grown;
+        randomOps(grown, "avl_small", 300, 20000, 3);
+        testMinMax(small, "avl_small");
+        testPop(small, "avl_small");
+        testErase(small, "avl_small");
+        testSetAlgebra<avl_small<int, 8>>("avl_small");
+    }
+    {
+        avl_hashed<int> hashed;
+        randomOps(hashed, "avl_hashed", 300, 20000, 4);
+        testMinMax(hashed, "avl_hashed");
+    }
+    {
+        // Small shards: splits & merges all along the way
+        avl_sharded<int> sharded(16);
+        randomOps(sharded, "avl_sharded", 300, 20000, 5);
+
+        avl_sharded<int> bounded(std::vector<int>{-200, 0, 200}, 32);
+        randomOps(bounded, "avl_sharded bounds", 300, 20000, 6);
+
+        testShardedThreads();
+    }
+    {
+        // Small blocks, and a wide range for the wide offsets
+        avl_compressed<long long, 8> narrow;
+        randomOps(narrow, "avl_compressed", 300LL, 20000, 7);
+        avl_compressed<long long, 8> wide;
+        randomOps(wide, "avl_compressed wide", 1LL << 40, 20000, 8);
+        testMinMax(narrow, "avl_compressed");
+    }
+
+    testMap();
+    testStrings();
+
+    testStatic<1>(9);
+    testStatic<2>(10);
+    testStatic<31>(11);
+    testStatic<100>(12);
+
+    if(failures == 0)
+        std::printf("all passed\n");
+
+    return failures < 100 ? failures : 100;
+}
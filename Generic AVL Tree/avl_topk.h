@@ -0,0 +1,182 @@
+#ifndef AVL_TOPK_H_
+#define AVL_TOPK_H_
+
+#include <functional>
+#include <vector>
+
+#include "avl_impl.h"
+
+
+/*
+ *  Bounded top-K set: keeps at most 'capacity' keys of a stream.
+ *  EVICT_MIN keeps the largest keys, EVICT_MAX the smallest.
+ *
+ *  offer() rejects in O(1) a candidate that would be evicted at once
+ *  (against the cached min/max), and otherwise inserts it and pops the
+ *  end of the eviction-side spine with no comparison (see avl::offer).
+ *
+ *  The bound lives here, so a plain avl stores nothing for it.
+ *  'Set' is an avl<T, Comp, ...> or an avl_small<T, N, Comp, ...>.
+ *  Updates go through this class, so the set is only given out as const.
+ */
+
+template <typename T, typename Comp = std::less<T>, typename Set = avl<T, Comp>>
+class avl_topk {
+    Set keys;
+    size_t capacity_bound;
+    AVL_EVICT evict_side;
+
+public:
+// Constractors:
+    explicit avl_topk(size_t capacity, AVL_EVICT evict = EVICT_MIN, const Comp& comp = Comp());
+
+// Operations:
+/* Inserts 'element' and evicts one key if the set is over capacity.
+ * Returns false if 'element' exists or would be the one evicted */
+    bool offer(const T& element);
+
+/* If the set is already bigger, the extra keys are evicted now */
+    void set_capacity(size_t capacity, AVL_EVICT evict = EVICT_MIN);
+    size_t capacity() const;
+
+    void remove(const T& element);
+    bool try_remove(const T& element);
+    bool contains(const T& element) const;
+
+    size_t rank(const T& key) const;
+    const T& select(size_t index) const;
+    const T& getMin() const;
+    const T& getMax() const;
+
+    size_t size() const;
+    bool empty() const;
+    std::vector<T> getAll() const;
+
+    /* For every other read-only operation */
+    const Set& ordered() const;
+
+// const-iterator (the set's):
+    typename Set::iterator begin();
+    typename Set::iterator end();
+};
+
+
+/*   ***   Constructors   ***   */
+
+template <typename T, typename Comp, typename Set>
+avl_topk<T, Comp, Set>::avl_topk(size_t capacity, AVL_EVICT evict, const Comp& comp)
+        : keys(comp), capacity_bound(capacity), evict_side(evict){
+}
+
+
+/*   ***   Operations   ***   */
+
+template <typename T, typename Comp, typename Set>
+bool
+avl_topk<T, Comp, Set>::offer(const T& element){
+    return keys.offer(element, capacity_bound, evict_side);
+}
+
+
+template <typename T, typename Comp, typename Set>
+void
+avl_topk<T, Comp, Set>::set_capacity(size_t capacity, AVL_EVICT evict){
+
+    capacity_bound = capacity;
+    evict_side = evict;
+
+    keys.shrink_to(capacity_bound, evict_side);
+}
+
+template <typename T, typename Comp, typename Set>
+size_t
+avl_topk<T, Comp, Set>::capacity() const{
+    return capacity_bound;
+}
+
+
+template <typename T, typename Comp, typename Set>
+void
+avl_topk<T, Comp, Set>::remove(const T& element){
+    keys.remove(element);
+}
+
+template <typename T, typename Comp, typename Set>
+bool
+avl_topk<T, Comp, Set>::try_remove(const T& element){
+    return keys.try_remove(element);
+}
+
+template <typename T, typename Comp, typename Set>
+bool
+avl_topk<T, Comp, Set>::contains(const T& element) const{
+    return keys.contains(element);
+}
+
+
+template <typename T, typename Comp, typename Set>
+size_t
+avl_topk<T, Comp, Set>::rank(const T& key) const{
+    return keys.rank(key);
+}
+
+template <typename T, typename Comp, typename Set>
+const T&
+avl_topk<T, Comp, Set>::select(size_t index) const{
+    return keys.select(index);
+}
+
+template <typename T, typename Comp, typename Set>
+const T&
+avl_topk<T, Comp, Set>::getMin() const{
+    return keys.getMin();
+}
+
+template <typename T, typename Comp, typename Set>
+const T&
+avl_topk<T, Comp, Set>::getMax() const{
+    return keys.getMax();
+}
+
+
+template <typename T, typename Comp, typename Set>
+size_t
+avl_topk<T, Comp, Set>::size() const{
+    return keys.size();
+}
+
+template <typename T, typename Comp, typename Set>
+bool
+avl_topk<T, Comp, Set>::empty() const{
+    return keys.empty();
+}
+
+template <typename T, typename Comp, typename Set>
+std::vector<T>
+avl_topk<T, Comp, Set>::getAll() const{
+    return keys.getAll();
+}
+
+template <typename T, typename Comp, typename Set>
+const Set&
+avl_topk<T, Comp, Set>::ordered() const{
+    return keys;
+}
+
+
+/*   ***   iterator functions   ***   */
+
+template <typename T, typename Comp, typename Set>
+typename Set::iterator
+avl_topk<T, Comp, Set>::begin(){
+    return keys.begin();
+}
+
+template <typename T, typename Comp, typename Set>
+typename Set::iterator
+avl_topk<T, Comp, Set>::end(){
+    return keys.end();
+}
+
+
+#endif /* AVL_TOPK_H_ */
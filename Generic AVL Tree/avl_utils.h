@@ -1,9 +1,17 @@
 #ifndef AVL_UTILITIES_H
 #define AVL_UTILITIES_H
 
+#include <functional>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include "avl_excep.h"
 
+#if __cplusplus >= 202002L
+#include <compare>
+#include <concepts>
+#endif
+
 enum AVL_STATUS {
     SUCCESS,
     FAILURE,
@@ -13,6 +21,140 @@ enum AVL_STATUS {
     WAS_HEIGHT_UPDATE
 };
 
+/* The side avl::offer() & avl_topk evict from, when the tree is at its capacity */
+enum AVL_EVICT {
+    EVICT_MIN,      // keeps the largest keys
+    EVICT_MAX       // keeps the smallest keys
+};
+
+/* Returned by the visitor of avl::scan() */
+enum AVL_VISIT {
+    VISIT_CONTINUE,
+    VISIT_STOP
+};
+
+/* Node order of avl::compact() */
+enum AVL_LAYOUT {
+    VAN_EMDE_BOAS,
+    BREADTH_FIRST
+};
+
+/* The set algebra operations of avl. For internal use */
+enum AVL_SET_OP {
+    SET_UNION,
+    SET_INTERSECTION,
+    SET_DIFFERENCE,
+    SET_SYMMETRIC_DIFFERENCE
+};
+
+
+/*   ***   Comparator traits   ***   */
+
+/*
+ *  'Comp' is either a less-than comparator (comp(a, b) is tested as a bool),
+ *  or a three-way comparator (comp(a, b) is compared with 0, like std::compare_three_way or strcmp).
+ *
+ *  Three-way is opt-in: a comparator returning a C++20 ordering is one,
+ *  and one returning an int must say so with a member, like is_transparent:
+ *      using is_three_way = void;
+ *  Any other comparator is less-than, so a legacy 'int operator()' returning a < b still works.
+ *
+ *  compare() returns <0, 0 or >0. 
+ *  It costs one call of a three-way comparator but two calls of a less-than one,
+ *  so the search loops of avl use it only when 'three_way' is true.
+ */
+template <typename...>
+struct avl_void {
+    typedef void type;
+};
+
+template <typename Comp, typename = void>
+struct avl_declares_three_way : std::false_type {};
+
+template <typename Comp>
+struct avl_declares_three_way<Comp, typename avl_void<typename Comp::is_three_way>::type> : std::true_type {};
+
+
+template <typename R>
+struct avl_is_ordering : std::false_type {};
+
+#if defined(__cpp_lib_three_way_comparison)
+template <> struct avl_is_ordering<std::strong_ordering> : std::true_type {};
+template <> struct avl_is_ordering<std::weak_ordering> : std::true_type {};
+template <> struct avl_is_ordering<std::partial_ordering> : std::true_type {};
+#endif
+
+
+template <typename T, typename Comp>
+struct avl_is_three_way {
+    using result = typename std::decay<decltype(std::declval<const Comp&>()(std::declval<const T&>(), 
+                                                                             std::declval<const T&>()))>::type;
+
+    static constexpr bool value = avl_declares_three_way<Comp>::value || avl_is_ordering<result>::value;
+};
+
+
+template <typename T, typename Comp, typename = void>
+struct avl_comp_traits {
+    static constexpr bool three_way = false;
+    
+    static constexpr bool less(const Comp& comp, const T& k1, const T& k2){
+        return bool(comp(k1, k2));
+    }
+    
+    static constexpr int compare(const Comp& comp, const T& k1, const T& k2){
+        return comp(k1, k2) ? -1 : (comp(k2, k1) ? 1 : 0);
+    }
+};
+
+
+template <typename T, typename Comp>
+struct avl_comp_traits<T, Comp, typename std::enable_if<avl_is_three_way<T, Comp>::value>::type> {
+    
+    static constexpr bool three_way = true;
+    
+    static constexpr bool less(const Comp& comp, const T& k1, const T& k2){
+        return comp(k1, k2) < 0;
+    }
+    
+    static constexpr int compare(const Comp& comp, const T& k1, const T& k2){
+        auto result = comp(k1, k2);
+        return (result < 0) ? -1 : ((result == 0) ? 0 : 1);
+    }
+};
+
+
+#if defined(__cpp_lib_three_way_comparison)
+/* The default std::less<T> of a type with operator<=> is served by one operator<=> */
+template <typename T>
+struct avl_comp_traits<T, std::less<T>, typename std::enable_if<std::three_way_comparable<T>>::type> {
+    
+    static constexpr bool three_way = true;
+    
+    static constexpr bool less(const std::less<T>& comp, const T& k1, const T& k2){
+        return comp(k1, k2);
+    }
+    
+    static constexpr int compare(const std::less<T>&, const T& k1, const T& k2){
+        auto result = k1 <=> k2;
+        return (result < 0) ? -1 : ((result == 0) ? 0 : 1);
+    }
+};
+#endif
+
+
+/* Less-than adaptor of any 'Comp', for std::sort and SetFunctor */
+template <typename T, typename Comp>
+struct avl_less_than {
+    const Comp& comp;
+    
+    explicit avl_less_than(const Comp& comp) : comp(comp){}
+    
+    bool operator()(const T& k1, const T& k2) const{
+        return avl_comp_traits<T, Comp>::less(comp, k1, k2);
+    }
+};
+
 
 /*   ***   Functors for internal use of inorder   ***   */
     
@@ -27,6 +169,24 @@ struct GetFunctor{
 };
 
 
+template <typename T, typename Pred>
+struct PartitionFunctor{
+    Pred& pred;
+    std::vector<T> kept;
+    std::vector<T> removed;
+    
+    explicit PartitionFunctor(Pred& pred) : pred(pred){}
+    
+    void operator()(const T& key){
+        
+        if(pred(key))
+            removed.push_back(key);
+        else
+            kept.push_back(key);
+    }
+};
+
+
 template <typename T, typename Comp, typename IterType>
 struct SetFunctor{
     IterType first, last;
@@ -40,11 +200,41 @@ struct SetFunctor{
         
         key = *first++;
 
-        if(first != last && (!k_cmp(key, *first)) && (!k_cmp(*first, key)))
+        if(first != last && avl_comp_traits<T, Comp>::compare(k_cmp, key, *first) == 0)
 
             throw non_unique_key<T>(*first);
     }
 };
 
 
+/*   ***   Empty-base holder for stateless policies   ***   */
+
+/*
+ *  Holds a policy object (stats, comparator...) as a private base when 
+ *  its type is empty, so it adds no bytes to the tree. 
+ *  'Tag' keeps two holders of the same type from clashing as bases.
+ */
+template <typename X, int Tag, bool = std::is_empty<X>::value && !std::is_final<X>::value>
+class avl_ebo : private X {
+public:
+    avl_ebo() = default;
+    constexpr explicit avl_ebo(const X& x) : X(x){}
+
+    constexpr X& get(){ return *this; }
+    constexpr const X& get() const{ return *this; }
+};
+
+template <typename X, int Tag>
+class avl_ebo<X, Tag, false> {
+    X value;
+
+public:
+    avl_ebo() = default;
+    constexpr explicit avl_ebo(const X& x) : value(x){}
+
+    constexpr X& get(){ return value; }
+    constexpr const X& get() const{ return value; }
+};
+
+
 #endif /* AVL_UTILITIES_H */